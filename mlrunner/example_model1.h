@@ -18,17 +18,33 @@
 
 // These are the accelerometer data filters needed for the model input data
 static const MlDataFilters_t example_mlDataFilters[] = {
-    {1, filterMax},
-    {1, filterMean},
-    {1, filterMin},
-    {1, filterStdDev},
-    {1, filterPeaks},
-    {1, filterTotalAcc},
-    {1, filterZcr},
-    {1, filterRms},
+    { .out_size = 1, .filter = filterMax },
+    { .out_size = 1, .filter = filterMean },
+    { .out_size = 1, .filter = filterMin },
+    { .out_size = 1, .filter = filterStdDev },
+    { .out_size = 1, .filter = filterPeaks },
+    { .out_size = 1, .filter = filterTotalAcc },
+    { .out_size = 1, .filter = filterZcr },
+    { .out_size = 1, .filter = filterRms },
 };
 static const int example_mlDataFiltersLen = sizeof(example_mlDataFilters) / sizeof(example_mlDataFilters[0]);
 
+#ifdef __cplusplus
+#include "mldppipeline.h"
+
+// The same filters as a pipeline specialised for the model window of 80 samples
+typedef MldpPipeline<80,
+    filterMax,
+    filterMean,
+    filterMin,
+    filterStdDev,
+    filterPeaks,
+    filterTotalAcc,
+    filterZcr,
+    filterRms
+> example_mlDataPipeline;
+#endif
+
 /* This is a struct representation of the header included at the beginning of model_example
 #include <mlrunner.h>
 const ml_model_header_t ml4f_model_example_header = {
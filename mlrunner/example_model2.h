@@ -18,7 +18,7 @@
 
 // These are the accelerometer data filters needed for the model input data
 static const MlDataFilters_t example_mlDataFilters[] = {
-    {750, filterPassThrough}
+    { .out_size = 750, .filter = filterPassThrough }
 };
 static const int example_mlDataFiltersLen = sizeof(example_mlDataFilters) / sizeof(example_mlDataFilters[0]);
 
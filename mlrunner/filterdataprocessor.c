@@ -5,168 +5,966 @@
  * Copyright 2024 Micro:bit Educational Foundation.
  * SPDX-License-Identifier: MIT
  *
- * TODO: Need to double buffer this so that a model can be run while the
- * next data is being collected.
+ * @details
+ * When configured as double buffered the processed data is calculated from
+ * a snapshot of the samples, so that the model can run on it while the next
+ * samples are still being recorded.
  */
+#include <stdint.h>
 #include <string.h>
 #include "mldataprocessor.h"
+#include "mldpkernels.h"
+#include "mldpincremental.h"
+#include "mldpstats.h"
+#include "mldpresampler.h"
+#include "mldpring.h"
 
 
-static float **input_samples = NULL;
-static float *temp_buffer = NULL;
-static int sample_dimensions = 0;
-static int sample_length = 0;
-static int sample_index = 0;
-static bool buffer_filled = false;
-static float *output_data = NULL;
-static int output_length = 0;
-static MlDataFilters_t *filters = NULL;
-static int filter_size = 0;
-static bool initialised = false;
+typedef struct {
+    float **input_samples;
+    int16_t **input_samples_i16;    // Used instead of input_samples for MLDP_STORAGE_INT16
+    float *scales;
+    float *inverse_scales;          // 1 / scales, in the same allocation
+    float *temp_buffer;
+    int sample_dimensions;          // Input dimensions followed by the derived channels
+    int input_dimensions;
+    const MldpDeriveFn_t *derived;
+    int sample_length;
+    int min_samples;                // Samples needed for the first window
+    int sample_index;
+    MldpLayout_t layout;
+    bool buffer_filled;
+    int hop;
+    int hop_index;                  // Samples since the last window
+    int windows_ready;              // New windows not reported by isDataReady() yet
+    float *frozen_samples;
+    int frozen_length;              // Samples in the snapshot, less than sample_length if partial
+    bool frozen;
+    float *output_data;
+    bool output_external;           // output_data is MlDataProcessorConfig_t.output_buffer
+    int output_length;
+    MlDataFilters_t *filters;
+    int filter_size;
+    const MldpPipeline_t *pipeline;
+    MldpIncremental_t *incremental;
+    int fused_filter_index;
+    MldpStats_t *stats;             // Per dimension statistics for the stats filters
+    uint32_t *stats_required;       // Per dimension MLDP_STAT_* flags
+    MldpResampler_t *resampler;     // NULL if the samples are recorded at the model period
+    float *resampled;               // Output of the resampler for each recorded sample
+    MldpRegrid_t *regrid;           // Grid for the samples with timestamps, NULL without a period
+    MldpRing_t *ring;               // Shared ring with the samples instead of input_samples
+    MldpRingView_t view;            // Window and readiness in the shared ring
+} FilterDataProcessor_t;
 
+// When this sequence of filters is found it's replaced by filterMlTrainer()
+static const MldpFilterFn_t ml_trainer_filters[MLDP_ML_TRAINER_OUT_SIZE] = {
+    filterMax,
+    filterMean,
+    filterMin,
+    filterStdDev,
+    filterPeaks,
+    filterTotalAcc,
+    filterZcr,
+    filterRms,
+};
+
+
+static MldpHandle_t filterDataProcessor_init(const MlDataProcessorConfig_t* config, MldpReturn_t *result);
+static void filterDataProcessor_deinit(MldpHandle_t handle);
+static MldpReturn_t filterDataProcessor_recordData(MldpHandle_t handle, const float *samples, const int elements);
+static MldpReturn_t filterDataProcessor_recordDataInt16(MldpHandle_t handle, const int16_t *samples, const int elements);
+static bool filterDataProcessor_isDataReady(MldpHandle_t handle, int *missed_hops);
+static float* filterDataProcessor_getProcessedData(MldpHandle_t handle);
+static size_t filterDataProcessor_getProcessedDataSize(MldpHandle_t handle);
+static MldpReturn_t filterDataProcessor_snapshot(MldpHandle_t handle);
+static void filterDataProcessor_commit(MldpHandle_t handle);
+static bool filterDataProcessor_isWindowPartial(MldpHandle_t handle);
+static MldpReturn_t filterDataProcessor_recordDataTimed(MldpHandle_t handle, const float *samples, const int elements, const uint32_t timestamp);
+static MldpReturn_t filterDataProcessor_recordDataTimedInt16(MldpHandle_t handle, const int16_t *samples, const int elements, const uint32_t timestamp);
+static MldpReturn_t filterDataProcessor_getJitter(MldpHandle_t handle, MldpJitter_t *jitter, const bool reset);
+static MldpReturn_t filterDataProcessor_getSamples(MldpHandle_t handle, float *data_out, const int dimensions, const int max_samples, int *samples);
+static MldpReturn_t filterDataProcessor_warmStart(MldpHandle_t handle, const MlDataProcessor_t *previous, MldpHandle_t previous_handle);
+
+
+static inline int total_dimensions(const MlDataProcessorConfig_t* config) {
+    return config->dimensions + config->derived_size;
+}
+
+static inline bool uses_dimension(const MlDataFilters_t *filter, const int dimension) {
+    return filter->dimensions == 0 || (dimension < 32 && (filter->dimensions & (1u << dimension)));
+}
+
+static inline bool uses_all_dimensions(const MlDataFilters_t *filter, const int dimensions) {
+    return filter->dimensions == 0 || (dimensions < 32 && filter->dimensions == (1u << dimensions) - 1);
+}
+
+/**
+ * @return The number of dimensions a filter is applied to.
+ */
+static int count_dimensions(const MlDataFilters_t *filter, const int dimensions) {
+    int count = 0;
+    for (int i = 0; i < dimensions; i++) {
+        if (uses_dimension(filter, i)) count++;
+    }
+    return count;
+}
+
+/**
+ * @return The number of samples in the window being recorded, which is
+ *         only less than sample_length before the buffer is filled.
+ */
+static inline int live_length(const FilterDataProcessor_t *dp) {
+    if (dp->ring != NULL) {
+        return mldpRing_windowLength(dp->ring, &dp->view);
+    }
+    return dp->buffer_filled ? dp->sample_length : dp->sample_index;
+}
+
+/**
+ * @return The number of samples in the window being processed.
+ */
+static inline int window_length(const FilterDataProcessor_t *dp) {
+    return dp->frozen ? dp->frozen_length : live_length(dp);
+}
+
+static inline float sample_at(const FilterDataProcessor_t *dp, const int dimension, const int index) {
+    if (dp->input_samples_i16 != NULL) {
+        return dp->input_samples_i16[dimension][index] * dp->scales[dimension];
+    }
+    return dp->input_samples[dimension][index];
+}
+
+/**
+ * @brief Copy the window of samples for a dimension in chronological order.
+ * Before the buffer is filled the window starts at the first sample.
+ */
+static void copy_window(const FilterDataProcessor_t *dp, const int dimension, float *buffer) {
+    const int length = live_length(dp);
+    if (dp->ring != NULL) {
+        mldpRing_copyWindow(dp->ring, dimension, length, buffer);
+        return;
+    }
+    const int start = dp->buffer_filled ? dp->sample_index : 0;
+    if (dp->input_samples_i16 != NULL) {
+        // The conversion has to go through every sample anyway
+        const int16_t *samples = dp->input_samples_i16[dimension];
+        const float scale = dp->scales[dimension];
+        for (int i = 0, s_i = start; i < length; i++, s_i++) {
+            if (s_i >= dp->sample_length && dp->layout == MLDP_LAYOUT_RING) s_i = 0;
+            buffer[i] = samples[s_i] * scale;
+        }
+        return;
+    }
+    if (dp->layout == MLDP_LAYOUT_MIRRORED || start == 0) {
+        memcpy(buffer, &dp->input_samples[dimension][start], length * sizeof(float));
+        return;
+    }
+    const int elements_left = dp->sample_length - start;
+    memcpy(buffer, &dp->input_samples[dimension][start], elements_left * sizeof(float));
+    memcpy(&buffer[elements_left], dp->input_samples[dimension], start * sizeof(float));
+}
 
-static MldpReturn_t filterDataProcessor_init(const MlDataProcessorConfig_t* config);
-static void filterDataProcessor_deinit();
-static MldpReturn_t filterDataProcessor_recordData(const float *samples, const int elements);
-static bool filterDataProcessor_isDataReady();
-static float* filterDataProcessor_getProcessedData();
+/**
+ * @brief Get the window of samples for a dimension in chronological order.
+ *
+ * A snapshot is already in order, and with the mirrored layout every sample
+ * is stored twice so the window is always contiguous. Otherwise the ring
+ * buffer is copied in order into the temporary buffer.
+ */
+static const float* get_window(FilterDataProcessor_t *dp, const int dimension) {
+    if (dp->frozen) {
+        return &dp->frozen_samples[dimension * dp->sample_length];
+    }
+    if (dp->layout == MLDP_LAYOUT_MIRRORED && dp->input_samples != NULL) {
+        return &dp->input_samples[dimension][dp->buffer_filled ? dp->sample_index : 0];
+    }
+    copy_window(dp, dimension, dp->temp_buffer);
+    return dp->temp_buffer;
+}
 
+/**
+ * @return The index of the first of the ML-Trainer filters in the config,
+ *         or -1 if they are not present in the same order.
+ */
+static int find_ml_trainer_filters(const MlDataProcessorConfig_t* config) {
+    for (int i = 0; i + MLDP_ML_TRAINER_OUT_SIZE <= config->filter_size; i++) {
+        bool found = true;
+        for (int j = 0; j < MLDP_ML_TRAINER_OUT_SIZE; j++) {
+            if (config->filters[i + j].filter != ml_trainer_filters[j] ||
+                config->filters[i + j].out_size != 1 ||
+                !uses_all_dimensions(&config->filters[i + j], total_dimensions(config))) {
+                found = false;
+                break;
+            }
+        }
+        if (found) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Smallest window accepted by a built-in filter, 1 for any other filter.
+ */
+static int filter_min_samples(const MldpFilterFn_t filter) {
+    if (filter == filterPeaks || filter == filterMlTrainer) {
+        return MLDP_PEAKS_LAG;
+    }
+    if (filter == filterZcr || filter == filterBandEnergy || filter == filterBandEnergyQ15) {
+        return 2;
+    }
+    return 1;
+}
 
-MldpReturn_t filterDataProcessor_init(const MlDataProcessorConfig_t* config) {
+static MldpReturn_t check_config(const MlDataProcessorConfig_t* config) {
     if (config->samples <= 0 || config->dimensions <= 0 || config->output_length <= 0) {
-        filterDataProcessor_deinit();
         return MLDP_ERROR_CONFIG;
     }
+    if (config->derived_size < 0 || (config->derived_size > 0 && config->derived == NULL)) {
+        return MLDP_ERROR_CONFIG;
+    }
+    const int dimensions = total_dimensions(config);
+    if (config->layout != MLDP_LAYOUT_RING && config->layout != MLDP_LAYOUT_MIRRORED) {
+        return MLDP_ERROR_CONFIG;
+    }
+    if (config->storage != MLDP_STORAGE_FLOAT && config->storage != MLDP_STORAGE_INT16) {
+        return MLDP_ERROR_CONFIG;
+    }
+    if (config->input_period < 0 || (config->input_period > 0 && config->samples_period <= 0)) {
+        return MLDP_ERROR_CONFIG;
+    }
+    if (config->hop < 0) {
+        return MLDP_ERROR_CONFIG;
+    }
+    if (config->min_fill < 0 || config->min_fill > 1 || (config->min_fill > 0 && config->pipeline != NULL)) {
+        return MLDP_ERROR_CONFIG;
+    }
+    // The window has to be long enough for the filters, so that a partial
+    // window can always be rounded up to their minimum
+    for (int i = 0; i < config->filter_size; i++) {
+        if (config->filters != NULL && config->samples < filter_min_samples(config->filters[i].filter)) {
+            return MLDP_ERROR_CONFIG;
+        }
+    }
+    // Only the samples are shared, the processing state for each one is not
+    if (config->ring != NULL && (config->dimensions != config->ring->dimensions ||
+            config->samples > config->ring->length || config->incremental ||
+            config->derived_size != 0 || config->input_period != 0)) {
+        return MLDP_ERROR_CONFIG;
+    }
+
+    // A pipeline has been built for a window length and already knows its output size
+    if (config->pipeline != NULL) {
+        if (config->incremental || config->filter_size != 0 ||
+                config->samples != config->pipeline->samples ||
+                config->output_length != config->pipeline->out_size * dimensions) {
+            return MLDP_ERROR_CONFIG;
+        }
+        return MLDP_SUCCESS;
+    }
 
-    // The output size will depend on output size per filter and number of dimensions
+    // The output size will depend on output size per filter and the number
+    // of dimensions each filter is applied to
     int total_output = 0;
     for (int i = 0; i < config->filter_size; i++) {
-        total_output += config->filters[i].out_size * config->dimensions;
+        // The mask cannot select dimensions that don't exist
+        if (dimensions < 32 && (config->filters[i].dimensions >> dimensions) != 0) {
+            return MLDP_ERROR_CONFIG;
+        }
+        total_output += config->filters[i].out_size * count_dimensions(&config->filters[i], dimensions);
     }
     if (config->output_length != total_output) {
-        filterDataProcessor_deinit();
         return MLDP_ERROR_CONFIG;
     }
 
-    if (initialised) {
-        filterDataProcessor_deinit();
-    }
+    return MLDP_SUCCESS;
+}
 
-    filters = (MlDataFilters_t*)malloc(config->filter_size * sizeof(MlDataFilters_t));
-    output_data = (float*)malloc(config->output_length * sizeof(float));
-    input_samples = (float**)calloc(config->dimensions, sizeof(float*));
-    if (filters == NULL || output_data == NULL || input_samples == NULL) {
-        filterDataProcessor_deinit();
+/**
+ * @brief Use the stats version of the filters run from the window, and
+ * allocate the statistics if any of them need it.
+ */
+static MldpReturn_t setup_stats(FilterDataProcessor_t *dp) {
+    dp->stats_required = (uint32_t*)calloc(dp->sample_dimensions, sizeof(uint32_t));
+    if (dp->stats_required == NULL) {
         return MLDP_ERROR_ALLOC;
     }
+    bool stats_needed = false;
+    for (int i = 0; i < dp->filter_size; i++) {
+        MlDataFilters_t *filter = &dp->filters[i];
+        if (filter->stats_filter == NULL) {
+            filter->stats_filter = mldpStats_findFilter(filter->filter, &filter->stats);
+        }
+        const bool is_fused = dp->fused_filter_index >= 0 && i >= dp->fused_filter_index &&
+                              i < dp->fused_filter_index + MLDP_ML_TRAINER_OUT_SIZE;
+        // Partial windows are processed from the samples, even for the incremental filters
+        const bool is_incremental = dp->incremental != NULL && mldpIncremental_isSupported(filter->filter) &&
+                                    dp->min_samples == dp->sample_length;
+        if (filter->stats_filter == NULL || filter->stats == 0 || is_fused || is_incremental) {
+            continue;
+        }
+        for (int dimension_i = 0; dimension_i < dp->sample_dimensions; dimension_i++) {
+            if (uses_dimension(filter, dimension_i)) {
+                dp->stats_required[dimension_i] |= filter->stats;
+                stats_needed = true;
+            }
+        }
+    }
+    if (stats_needed) {
+        dp->stats = (MldpStats_t*)calloc(dp->sample_dimensions, sizeof(MldpStats_t));
+        if (dp->stats == NULL) {
+            return MLDP_ERROR_ALLOC;
+        }
+    }
+    return MLDP_SUCCESS;
+}
 
-    // Allocate for each sample dimension, and the temporary buffer
-    sample_dimensions = config->dimensions;
-    for (int i = 0; i < sample_dimensions; i++) {
-        input_samples[i] = (float*)malloc(config->samples * sizeof(float));
-        if (input_samples[i] == NULL) {
-            filterDataProcessor_deinit();
+static MldpReturn_t allocate(FilterDataProcessor_t *dp, const MlDataProcessorConfig_t* config) {
+    if (config->filter_size > 0) {
+        dp->filters = (MlDataFilters_t*)malloc(config->filter_size * sizeof(MlDataFilters_t));
+        if (dp->filters == NULL) {
             return MLDP_ERROR_ALLOC;
         }
     }
-    temp_buffer = (float*)malloc(config->samples * sizeof(float));
-    if (temp_buffer == NULL) {
-        filterDataProcessor_deinit();
+    dp->output_external = config->output_buffer != NULL;
+    dp->output_data = dp->output_external ?
+        config->output_buffer : (float*)malloc(config->output_length * sizeof(float));
+    dp->input_dimensions = config->dimensions;
+    dp->sample_dimensions = total_dimensions(config);
+    dp->derived = config->derived;
+    dp->sample_length = config->samples;
+    dp->min_samples = config->samples;
+    if (config->min_fill > 0) {
+        // Rounded up, with at least one sample
+        const float min_samples = config->min_fill * config->samples;
+        dp->min_samples = (int)min_samples < min_samples ? (int)min_samples + 1 : (int)min_samples;
+        if (dp->min_samples < 1) dp->min_samples = 1;
+        // A partial window still has to be long enough for every filter
+        for (int i = 0; i < config->filter_size; i++) {
+            const int filter_min = filter_min_samples(config->filters[i].filter);
+            if (dp->min_samples < filter_min) dp->min_samples = filter_min;
+        }
+    }
+    dp->ring = config->ring;
+    dp->scales = (float*)malloc(2 * dp->sample_dimensions * sizeof(float));
+    dp->inverse_scales = dp->scales != NULL ? &dp->scales[dp->sample_dimensions] : NULL;
+    if (dp->ring != NULL) {
+        // The samples are stored by the shared ring
+    } else if (config->storage == MLDP_STORAGE_INT16) {
+        dp->input_samples_i16 = (int16_t**)calloc(dp->sample_dimensions, sizeof(int16_t*));
+    } else {
+        dp->input_samples = (float**)calloc(dp->sample_dimensions, sizeof(float*));
+    }
+    if (dp->output_data == NULL || dp->scales == NULL ||
+            (dp->ring == NULL && dp->input_samples == NULL && dp->input_samples_i16 == NULL)) {
         return MLDP_ERROR_ALLOC;
     }
+    for (int i = 0; i < dp->sample_dimensions; i++) {
+        // The derived channels use the scale of the first input dimension
+        const int scale_i = i < dp->input_dimensions ? i : 0;
+        dp->scales[i] = config->scale != NULL ? config->scale[scale_i] : 1.0f;
+        if (dp->scales[i] == 0.0f) {
+            return MLDP_ERROR_CONFIG;
+        }
+        // So that quantising a sample is a multiplication
+        dp->inverse_scales[i] = 1.0f / dp->scales[i];
+    }
+
+    // Allocate for each sample dimension, and the temporary buffer only
+    // needed to reorder the ring layout or to convert int16 samples
+    dp->layout = dp->ring != NULL ? MLDP_LAYOUT_RING : config->layout;
+    const int ring_length = dp->layout == MLDP_LAYOUT_MIRRORED ? config->samples * 2 : config->samples;
+    for (int i = 0; dp->ring == NULL && i < dp->sample_dimensions; i++) {
+        if (dp->input_samples_i16 != NULL) {
+            dp->input_samples_i16[i] = (int16_t*)calloc(ring_length, sizeof(int16_t));
+        } else {
+            dp->input_samples[i] = (float*)calloc(ring_length, sizeof(float));
+        }
+        if ((dp->input_samples_i16 != NULL && dp->input_samples_i16[i] == NULL) ||
+                (dp->input_samples != NULL && dp->input_samples[i] == NULL)) {
+            return MLDP_ERROR_ALLOC;
+        }
+    }
+    if (config->double_buffered) {
+        dp->frozen_samples = (float*)malloc(dp->sample_dimensions * config->samples * sizeof(float));
+        if (dp->frozen_samples == NULL) {
+            return MLDP_ERROR_ALLOC;
+        }
+    }
+    const bool live_copy = dp->layout == MLDP_LAYOUT_RING || dp->input_samples_i16 != NULL;
+    if ((!config->double_buffered && live_copy) || (dp->input_samples_i16 != NULL && config->incremental)) {
+        dp->temp_buffer = (float*)malloc(config->samples * sizeof(float));
+        if (dp->temp_buffer == NULL) {
+            return MLDP_ERROR_ALLOC;
+        }
+    }
+
+    // The incremental state is kept per dimension
+    if (config->incremental) {
+        dp->incremental = (MldpIncremental_t*)calloc(dp->sample_dimensions, sizeof(MldpIncremental_t));
+        if (dp->incremental == NULL) {
+            return MLDP_ERROR_ALLOC;
+        }
+        for (int i = 0; i < dp->sample_dimensions; i++) {
+            MldpReturn_t inc_result = mldpIncremental_init(
+                &dp->incremental[i], config->samples, config->filters, config->filter_size);
+            if (inc_result != MLDP_SUCCESS) {
+                return inc_result;
+            }
+        }
+    }
+
+    // Only the input dimensions are resampled, the derived channels are
+    // calculated from the resampled values
+    if (config->input_period > 0 && config->input_period != config->samples_period) {
+        dp->resampler = (MldpResampler_t*)calloc(1, sizeof(MldpResampler_t));
+        if (dp->resampler == NULL) {
+            return MLDP_ERROR_ALLOC;
+        }
+        MldpReturn_t rs_result = mldpResampler_init(
+            dp->resampler, dp->input_dimensions, config->input_period, config->samples_period);
+        if (rs_result != MLDP_SUCCESS) {
+            return rs_result;
+        }
+        dp->resampled = (float*)malloc(
+            mldpResampler_maxOutputs(dp->resampler) * dp->input_dimensions * sizeof(float));
+        if (dp->resampled == NULL) {
+            return MLDP_ERROR_ALLOC;
+        }
+    }
+
+    // The timestamped samples are placed on the grid of the recorded samples
+    const int grid_period = config->input_period > 0 ? config->input_period : config->samples_period;
+    if (grid_period > 0 && dp->ring == NULL) {
+        dp->regrid = (MldpRegrid_t*)calloc(1, sizeof(MldpRegrid_t));
+        if (dp->regrid == NULL) {
+            return MLDP_ERROR_ALLOC;
+        }
+        MldpReturn_t rg_result = mldpRegrid_init(dp->regrid, dp->input_dimensions, grid_period);
+        if (rg_result != MLDP_SUCCESS) {
+            return rg_result;
+        }
+    }
 
     // Copy the filter pointers
-    memcpy(filters, config->filters, config->filter_size * sizeof(MlDataFilters_t));
+    if (config->filter_size > 0) {
+        memcpy(dp->filters, config->filters, config->filter_size * sizeof(MlDataFilters_t));
+    }
+    dp->filter_size = config->filter_size;
 
-    filter_size = config->filter_size;
-    output_length = config->output_length;
-    sample_length = config->samples;
-    sample_index = 0;
+    // With the incremental state the fused filter would only save a pass for
+    // the peaks, so it's only used if the window has to be processed anyway
+    dp->fused_filter_index = config->incremental ? -1 : find_ml_trainer_filters(config);
 
-    initialised = true;
-    return MLDP_SUCCESS;
+    MldpReturn_t stats_result = setup_stats(dp);
+    if (stats_result != MLDP_SUCCESS || dp->ring == NULL) {
+        return stats_result;
+    }
+    MldpReturn_t ring_result = mldpRing_attach(dp->ring, &dp->view, dp->sample_length, dp->min_samples, config->hop);
+    if (ring_result != MLDP_SUCCESS) {
+        // Not attached, so it's not detached on deinit
+        dp->ring = NULL;
+    }
+    return ring_result;
+}
+
+MldpHandle_t filterDataProcessor_init(const MlDataProcessorConfig_t* config, MldpReturn_t *result) {
+    MldpReturn_t init_result = check_config(config);
+    FilterDataProcessor_t *dp = NULL;
+    if (init_result == MLDP_SUCCESS) {
+        dp = (FilterDataProcessor_t*)calloc(1, sizeof(FilterDataProcessor_t));
+        init_result = dp == NULL ? MLDP_ERROR_ALLOC : allocate(dp, config);
+    }
+    if (result != NULL) {
+        *result = init_result;
+    }
+    if (init_result != MLDP_SUCCESS) {
+        filterDataProcessor_deinit((MldpHandle_t)dp);
+        return NULL;
+    }
+
+    dp->pipeline = config->pipeline;
+    dp->output_length = config->output_length;
+    dp->sample_index = 0;
+    dp->buffer_filled = false;
+    dp->hop = config->hop > 0 ? config->hop : 1;
+    dp->hop_index = 0;
+    dp->windows_ready = 0;
+
+    return (MldpHandle_t)dp;
+}
+
+void filterDataProcessor_deinit(MldpHandle_t handle) {
+    FilterDataProcessor_t *dp = (FilterDataProcessor_t*)handle;
+    if (dp == NULL) return;
+
+    if (dp->ring != NULL) mldpRing_detach(dp->ring, &dp->view);
+    for (int i = 0; i < dp->sample_dimensions; i++) {
+        if (dp->input_samples != NULL) free(dp->input_samples[i]);
+        if (dp->input_samples_i16 != NULL) free(dp->input_samples_i16[i]);
+        if (dp->incremental != NULL) mldpIncremental_deinit(&dp->incremental[i]);
+    }
+    free(dp->input_samples);
+    free(dp->input_samples_i16);
+    free(dp->scales);
+    free(dp->incremental);
+    free(dp->stats);
+    free(dp->stats_required);
+    free(dp->temp_buffer);
+    free(dp->frozen_samples);
+    if (!dp->output_external) {
+        free(dp->output_data);
+    }
+    free(dp->filters);
+    if (dp->resampler != NULL) mldpResampler_deinit(dp->resampler);
+    free(dp->resampler);
+    free(dp->resampled);
+    if (dp->regrid != NULL) mldpRegrid_deinit(dp->regrid);
+    free(dp->regrid);
+    free(dp);
+}
+
+/**
+ * @brief Store a sample value for a dimension at the current sample_index.
+ *
+ * @param value The sample value, as it would be read back from storage.
+ * @param raw The sample value when stored as int16.
+ */
+static void store_sample(FilterDataProcessor_t *dp, const int dimension, const float value, const int16_t raw) {
+    if (dp->incremental != NULL) {
+        // Before it's overwritten, sample_index points to the oldest sample
+        mldpIncremental_push(
+            &dp->incremental[dimension], value, sample_at(dp, dimension, dp->sample_index),
+            sample_at(dp, dimension, (dp->sample_index + 1) % dp->sample_length));
+    }
+    if (dp->input_samples_i16 != NULL) {
+        dp->input_samples_i16[dimension][dp->sample_index] = raw;
+        if (dp->layout == MLDP_LAYOUT_MIRRORED) {
+            dp->input_samples_i16[dimension][dp->sample_index + dp->sample_length] = raw;
+        }
+    } else {
+        dp->input_samples[dimension][dp->sample_index] = value;
+        if (dp->layout == MLDP_LAYOUT_MIRRORED) {
+            dp->input_samples[dimension][dp->sample_index + dp->sample_length] = value;
+        }
+    }
+}
+
+// Move to the next sample, after all dimensions have been stored
+static void next_sample(FilterDataProcessor_t *dp) {
+    dp->sample_index++;
+    // The first window is ready with min_samples, and then every hop
+    if (!dp->buffer_filled && dp->sample_index == dp->min_samples) {
+        dp->hop_index = 0;
+        dp->windows_ready++;
+    } else if ((dp->buffer_filled || dp->sample_index > dp->min_samples) && ++dp->hop_index >= dp->hop) {
+        dp->hop_index = 0;
+        dp->windows_ready++;
+    }
+    if (dp->sample_index >= dp->sample_length) {
+        dp->sample_index = 0;
+        dp->buffer_filled = true;
+        // The window is in chronological order once per lap, which is a
+        // good point to discard the accumulated floating point errors
+        if (dp->incremental != NULL) {
+            for (int d_i = 0; d_i < dp->sample_dimensions; d_i++) {
+                if (dp->input_samples_i16 != NULL) {
+                    copy_window(dp, d_i, dp->temp_buffer);
+                    mldpIncremental_reseed(&dp->incremental[d_i], dp->temp_buffer);
+                } else {
+                    mldpIncremental_reseed(&dp->incremental[d_i], dp->input_samples[d_i]);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Store a sample value for a dimension, quantising it if stored as
+ * int16 so that the incremental state sees the stored value.
+ *
+ * @return The value as it has been stored.
+ */
+static float store_value(FilterDataProcessor_t *dp, const int dimension, const float value) {
+    if (dp->input_samples_i16 == NULL) {
+        store_sample(dp, dimension, value, 0);
+        return value;
+    }
+    const int16_t raw = mldpKernel_quantise(value, dp->inverse_scales[dimension]);
+    const float stored = raw * dp->scales[dimension];
+    store_sample(dp, dimension, stored, raw);
+    return stored;
+}
+
+// Calculate and store the derived channels from the input dimensions of a sample
+static void store_derived(FilterDataProcessor_t *dp, const float *sample) {
+    for (int i = 0; i < dp->sample_dimensions - dp->input_dimensions; i++) {
+        store_value(dp, dp->input_dimensions + i, dp->derived[i](sample, dp->input_dimensions));
+    }
+}
+
+// Store all the dimensions of a sample at the model period
+static void record_sample(FilterDataProcessor_t *dp, const float *sample) {
+    float stored[dp->input_dimensions];
+    for (int d_i = 0; d_i < dp->input_dimensions; d_i++) {
+        stored[d_i] = store_value(dp, d_i, sample[d_i]);
+    }
+    store_derived(dp, stored);
+    next_sample(dp);
 }
 
-void filterDataProcessor_deinit() {
-    initialised = false;
-    for (int i = 0; i < sample_dimensions; i++) {
-        free(input_samples[i]);
+// Resample a recorded sample and store the samples produced at the model period
+static void record_resampled(FilterDataProcessor_t *dp, const float *sample) {
+    const int outputs = mldpResampler_push(dp->resampler, sample, dp->resampled);
+    for (int o_i = 0; o_i < outputs; o_i++) {
+        record_sample(dp, &dp->resampled[o_i * dp->input_dimensions]);
     }
-    free(input_samples);
-    free(temp_buffer);
-    free(output_data);
-    free(filters);
-    input_samples = NULL;
-    output_data = NULL;
-    filters = NULL;
-    filter_size = 0;
-    output_length = 0;
-    sample_dimensions = 0;
-    sample_length = 0;
-    sample_index = 0;
 }
 
-MldpReturn_t filterDataProcessor_recordData(const float* samples, const int elements) {
-    if (!initialised) return MLDP_ERROR_NOINIT;
-    // Only record data if the number of elements is a multiple of the sample dimensions
-    if (elements % sample_dimensions != 0) return MLDP_ERROR_CONFIG;
+MldpReturn_t filterDataProcessor_recordData(MldpHandle_t handle, const float* samples, const int elements) {
+    FilterDataProcessor_t *dp = (FilterDataProcessor_t*)handle;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    // Only record data if the number of elements is a multiple of the sample dimensions,
+    // and with a shared ring the samples are recorded into the ring
+    if (elements % dp->input_dimensions != 0 || dp->ring != NULL) return MLDP_ERROR_CONFIG;
 
-    int number_of_samples = elements / sample_dimensions;
+    int number_of_samples = elements / dp->input_dimensions;
     for (int s_i = 0; s_i < number_of_samples; s_i++) {
-        for (int d_i = 0; d_i < sample_dimensions; d_i++) {
-            input_samples[d_i][sample_index + s_i] = samples[s_i * sample_dimensions + d_i];
+        if (dp->resampler != NULL) {
+            record_resampled(dp, &samples[s_i * dp->input_dimensions]);
+        } else {
+            record_sample(dp, &samples[s_i * dp->input_dimensions]);
         }
-        sample_index++;
-        if (sample_index >= sample_length) {
-            sample_index = 0;
-            buffer_filled = true;
+    }
+
+    return MLDP_SUCCESS;
+}
+
+MldpReturn_t filterDataProcessor_recordDataInt16(MldpHandle_t handle, const int16_t* samples, const int elements) {
+    FilterDataProcessor_t *dp = (FilterDataProcessor_t*)handle;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    if (elements % dp->input_dimensions != 0 || dp->ring != NULL) return MLDP_ERROR_CONFIG;
+
+    float values[dp->input_dimensions];
+    int number_of_samples = elements / dp->input_dimensions;
+    for (int s_i = 0; s_i < number_of_samples; s_i++) {
+        // The resampled values are no longer in the int16 grid
+        if (dp->resampler != NULL) {
+            for (int d_i = 0; d_i < dp->input_dimensions; d_i++) {
+                values[d_i] = samples[s_i * dp->input_dimensions + d_i] * dp->scales[d_i];
+            }
+            record_resampled(dp, values);
+            continue;
+        }
+        for (int d_i = 0; d_i < dp->input_dimensions; d_i++) {
+            const int16_t raw = samples[s_i * dp->input_dimensions + d_i];
+            values[d_i] = raw * dp->scales[d_i];
+            store_sample(dp, d_i, values[d_i], raw);
         }
+        store_derived(dp, values);
+        next_sample(dp);
     }
 
     return MLDP_SUCCESS;
 }
 
-bool filterDataProcessor_isDataReady() {
-    if (!initialised) return false;
+MldpReturn_t filterDataProcessor_recordDataTimed(MldpHandle_t handle, const float* samples, const int elements, const uint32_t timestamp) {
+    FilterDataProcessor_t *dp = (FilterDataProcessor_t*)handle;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    // A single sample, and the grid needs to know the period
+    if (elements != dp->input_dimensions || dp->regrid == NULL) return MLDP_ERROR_CONFIG;
+    if (!mldpRegrid_push(dp->regrid, samples, timestamp)) return MLDP_ERROR;
 
-    return buffer_filled;
+    float sample[dp->input_dimensions];
+    while (mldpRegrid_next(dp->regrid, sample)) {
+        if (dp->resampler != NULL) {
+            record_resampled(dp, sample);
+        } else {
+            record_sample(dp, sample);
+        }
+    }
+
+    return MLDP_SUCCESS;
 }
 
-float* filterDataProcessor_getProcessedData() {
-    if (!initialised) return NULL;
-    if (!buffer_filled) return NULL;
+MldpReturn_t filterDataProcessor_recordDataTimedInt16(MldpHandle_t handle, const int16_t* samples, const int elements, const uint32_t timestamp) {
+    FilterDataProcessor_t *dp = (FilterDataProcessor_t*)handle;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    if (elements != dp->input_dimensions || dp->regrid == NULL) return MLDP_ERROR_CONFIG;
+
+    // Interpolated in raw units, so the grid samples are stored as int16
+    // without converting them to float and back
+    float raw[dp->input_dimensions];
+    for (int d_i = 0; d_i < dp->input_dimensions; d_i++) {
+        raw[d_i] = samples[d_i];
+    }
+    if (!mldpRegrid_push(dp->regrid, raw, timestamp)) return MLDP_ERROR;
+
+    int16_t sample[dp->input_dimensions];
+    while (mldpRegrid_next(dp->regrid, raw)) {
+        for (int d_i = 0; d_i < dp->input_dimensions; d_i++) {
+            sample[d_i] = mldpKernel_quantise(raw[d_i], 1.0f);
+        }
+        filterDataProcessor_recordDataInt16(handle, sample, elements);
+    }
 
-    // Run all filters and save their output to output_data
+    return MLDP_SUCCESS;
+}
+
+MldpReturn_t filterDataProcessor_getJitter(MldpHandle_t handle, MldpJitter_t *jitter, const bool reset) {
+    FilterDataProcessor_t *dp = (FilterDataProcessor_t*)handle;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    if (dp->regrid == NULL) return MLDP_ERROR_CONFIG;
+
+    *jitter = dp->regrid->jitter;
+    if (reset) mldpRegrid_resetJitter(dp->regrid);
+
+    return MLDP_SUCCESS;
+}
+
+bool filterDataProcessor_isDataReady(MldpHandle_t handle, int *missed_hops) {
+    FilterDataProcessor_t *dp = (FilterDataProcessor_t*)handle;
+    if (missed_hops != NULL) *missed_hops = 0;
+    if (dp == NULL) return false;
+
+    // A new snapshot cannot be taken until the current one is committed, the
+    // windows completed in the meantime are reported as missed
+    if (dp->frozen) return false;
+    if (dp->ring != NULL) return mldpRing_isReady(&dp->view, missed_hops);
+    if (dp->windows_ready == 0) return false;
+    if (missed_hops != NULL) *missed_hops = dp->windows_ready - 1;
+    dp->windows_ready = 0;
+    return true;
+}
+
+/**
+ * @brief Run the filters and save their output to output_data.
+ *
+ * @param from_state If true only run the filters calculated from the
+ *                   incremental state, otherwise only the ones that need the
+ *                   window of samples.
+ * @return True if all the filters run successfully.
+ */
+static bool run_filters(FilterDataProcessor_t *dp, const bool from_state) {
+    // The incremental state assumes a full window, a partial one is
+    // processed from the samples
+    const int length = window_length(dp);
+    const bool use_state = dp->incremental != NULL && length == dp->sample_length;
+
+    // The pipeline has been validated at compile time and always needs the window
+    if (dp->pipeline != NULL) {
+        if (!from_state) {
+            for (int dimension_i = 0; dimension_i < dp->sample_dimensions; dimension_i++) {
+                dp->pipeline->process(get_window(dp, dimension_i), dp->output_data, dimension_i, dp->sample_dimensions);
+            }
+        }
+        return true;
+    }
+
+    const MlDataFilters_t *filters = dp->filters;
+    const int sample_dimensions = dp->sample_dimensions;
+    float *output_data = dp->output_data;
     int output_i = 0;
-    for (int filter_i = 0; filter_i < filter_size; filter_i++) {
+    // The statistics for all the stats filters are calculated in a single
+    // pass through the window of each dimension
+    if (!from_state && dp->stats != NULL) {
         for (int dimension_i = 0; dimension_i < sample_dimensions; dimension_i++) {
-            const int elements_left = sample_length - sample_index;
-            memcpy(temp_buffer, &input_samples[dimension_i][sample_index], elements_left * sizeof(float));
-            memcpy(&temp_buffer[elements_left], input_samples[dimension_i], sample_index * sizeof(float));
+            mldpStats_reset(&dp->stats[dimension_i], length);
+            if (dp->stats_required[dimension_i] != 0) {
+                mldpStats_compute(&dp->stats[dimension_i], get_window(dp, dimension_i), dp->stats_required[dimension_i]);
+            }
+        }
+    }
+    for (int filter_i = 0; filter_i < dp->filter_size; filter_i++) {
+        const int filter_output = filters[filter_i].out_size * count_dimensions(&filters[filter_i], sample_dimensions);
+        // Filters already tracked as the samples were recorded don't need the window
+        const bool is_incremental = use_state && mldpIncremental_isSupported(filters[filter_i].filter);
+        if (is_incremental != from_state) {
+            output_i += filter_output;
+            continue;
+        }
+        if (is_incremental) {
+            for (int dimension_i = 0; dimension_i < sample_dimensions; dimension_i++) {
+                if (!uses_dimension(&filters[filter_i], dimension_i)) continue;
+                MldpReturn_t filter_result = mldpIncremental_output(
+                    &dp->incremental[dimension_i], filters[filter_i].filter,
+                    &output_data[output_i], filters[filter_i].out_size
+                );
+                if (filter_result != MLDP_SUCCESS) {
+                    return false;
+                }
+                output_i += filters[filter_i].out_size;
+            }
+            continue;
+        }
+        // The fused filter outputs all the ML-Trainer filters for one dimension,
+        // so its output is spread to keep it grouped by filter
+        if (filter_i == dp->fused_filter_index) {
+            for (int dimension_i = 0; dimension_i < sample_dimensions; dimension_i++) {
+                float fused_output[MLDP_ML_TRAINER_OUT_SIZE];
+                MldpReturn_t filter_result = filterMlTrainer(
+                    get_window(dp, dimension_i), length, fused_output, MLDP_ML_TRAINER_OUT_SIZE);
+                if (filter_result != MLDP_SUCCESS) {
+                    return false;
+                }
+                for (int i = 0; i < MLDP_ML_TRAINER_OUT_SIZE; i++) {
+                    output_data[output_i + i * sample_dimensions + dimension_i] = fused_output[i];
+                }
+            }
+            output_i += MLDP_ML_TRAINER_OUT_SIZE * sample_dimensions;
+            filter_i += MLDP_ML_TRAINER_OUT_SIZE - 1;
+            continue;
+        }
+        if (filters[filter_i].stats_filter != NULL && dp->stats != NULL) {
+            for (int dimension_i = 0; dimension_i < sample_dimensions; dimension_i++) {
+                if (!uses_dimension(&filters[filter_i], dimension_i)) continue;
+                MldpReturn_t filter_result = filters[filter_i].stats_filter(
+                    &dp->stats[dimension_i], &output_data[output_i], filters[filter_i].out_size
+                );
+                if (filter_result != MLDP_SUCCESS) {
+                    return false;
+                }
+                output_i += filters[filter_i].out_size;
+            }
+            continue;
+        }
+        for (int dimension_i = 0; dimension_i < sample_dimensions; dimension_i++) {
+            if (!uses_dimension(&filters[filter_i], dimension_i)) continue;
             MldpReturn_t filter_result = filters[filter_i].filter(
-                temp_buffer, sample_length,
+                get_window(dp, dimension_i), length,
                 &output_data[output_i], filters[filter_i].out_size
             );
             if (filter_result != MLDP_SUCCESS) {
-                return NULL;
+                return false;
             }
             output_i += filters[filter_i].out_size;
         }
     }
-    return output_data;
+    return true;
+}
+
+float* filterDataProcessor_getProcessedData(MldpHandle_t handle) {
+    FilterDataProcessor_t *dp = (FilterDataProcessor_t*)handle;
+    if (dp == NULL) return NULL;
+
+    // When double buffered the data is processed from the snapshot, where the
+    // incremental filters have already been calculated
+    if (dp->frozen_samples != NULL) {
+        if (!dp->frozen) return NULL;
+        return run_filters(dp, false) ? dp->output_data : NULL;
+    }
+
+    if (live_length(dp) < dp->min_samples) return NULL;
+    if (!run_filters(dp, true) || !run_filters(dp, false)) {
+        return NULL;
+    }
+    return dp->output_data;
+}
+
+MldpReturn_t filterDataProcessor_snapshot(MldpHandle_t handle) {
+    FilterDataProcessor_t *dp = (FilterDataProcessor_t*)handle;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    // Without double buffering the data is processed from the live buffer
+    if (dp->frozen_samples == NULL) return MLDP_SUCCESS;
+    if (dp->frozen) return MLDP_ERROR_BUSY;
+    if (live_length(dp) < dp->min_samples) return MLDP_ERROR_NODATA;
+
+    for (int dimension_i = 0; dimension_i < dp->sample_dimensions; dimension_i++) {
+        copy_window(dp, dimension_i, &dp->frozen_samples[dimension_i * dp->sample_length]);
+    }
+    dp->frozen_length = live_length(dp);
+    // The incremental state keeps changing with new samples, so its output
+    // has to be captured at the same time
+    if (!run_filters(dp, true)) {
+        return MLDP_ERROR;
+    }
+    dp->frozen = true;
+
+    return MLDP_SUCCESS;
+}
+
+void filterDataProcessor_commit(MldpHandle_t handle) {
+    FilterDataProcessor_t *dp = (FilterDataProcessor_t*)handle;
+    if (dp == NULL) return;
+
+    dp->frozen = false;
+}
+
+MldpReturn_t filterDataProcessor_getSamples(MldpHandle_t handle, float *data_out, const int dimensions, const int max_samples, int *samples) {
+    const FilterDataProcessor_t *dp = (const FilterDataProcessor_t*)handle;
+    if (samples != NULL) *samples = 0;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    if (dimensions != dp->input_dimensions || max_samples < 0) return MLDP_ERROR_CONFIG;
+
+    // The derived channels are not copied, they are calculated from the inputs
+    const int available = live_length(dp);
+    const int count = max_samples < available ? max_samples : available;
+    int s_i = dp->sample_index - count;
+    if (s_i < 0) s_i += dp->sample_length;
+    for (int i = 0; i < count; i++, s_i++) {
+        if (s_i >= dp->sample_length) s_i = 0;
+        for (int d_i = 0; d_i < dp->input_dimensions; d_i++) {
+            data_out[i * dp->input_dimensions + d_i] = dp->ring != NULL ?
+                mldpRing_sampleAt(dp->ring, d_i, count - 1 - i) : sample_at(dp, d_i, s_i);
+        }
+    }
+    if (samples != NULL) *samples = count;
+
+    return MLDP_SUCCESS;
+}
+
+MldpReturn_t filterDataProcessor_warmStart(MldpHandle_t handle, const MlDataProcessor_t *previous, MldpHandle_t previous_handle) {
+    FilterDataProcessor_t *dp = (FilterDataProcessor_t*)handle;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    if (previous == NULL || previous_handle == NULL) return MLDP_ERROR_CONFIG;
+    if (dp->sample_index != 0 || dp->buffer_filled) return MLDP_ERROR;
+    if (dp->ring != NULL) return MLDP_ERROR_CONFIG;
+
+    // A longer window is filled partially, and a shorter one with the newest samples
+    float *samples = (float*)malloc(dp->sample_length * dp->input_dimensions * sizeof(float));
+    if (samples == NULL) return MLDP_ERROR_ALLOC;
+    int count = 0;
+    MldpReturn_t result = previous->getSamples(
+        previous_handle, samples, dp->input_dimensions, dp->sample_length, &count);
+    // Already at the model period, so they skip the resampler
+    for (int s_i = 0; result == MLDP_SUCCESS && s_i < count; s_i++) {
+        record_sample(dp, &samples[s_i * dp->input_dimensions]);
+    }
+    free(samples);
+
+    return result;
+}
+
+bool filterDataProcessor_isWindowPartial(MldpHandle_t handle) {
+    const FilterDataProcessor_t *dp = (const FilterDataProcessor_t*)handle;
+    if (dp == NULL) return false;
+
+    return window_length(dp) < dp->sample_length;
 }
 
-size_t filterDataProcessor_getProcessedDataSize() {
-    if (!initialised) return 0;
+size_t filterDataProcessor_getProcessedDataSize(MldpHandle_t handle) {
+    const FilterDataProcessor_t *dp = (const FilterDataProcessor_t*)handle;
+    if (dp == NULL) return 0;
 
-    return output_length;
+    return dp->output_length;
 }
 
-MlDataProcessor_t mlDataProcessor = {
+const MlDataProcessor_t mlFilterDataProcessor = {
     .init = filterDataProcessor_init,
     .deinit = filterDataProcessor_deinit,
     .recordData = filterDataProcessor_recordData,
+    .recordDataInt16 = filterDataProcessor_recordDataInt16,
     .isDataReady = filterDataProcessor_isDataReady,
     .getProcessedData = filterDataProcessor_getProcessedData,
     .getProcessedDataSize = filterDataProcessor_getProcessedDataSize,
+    .snapshot = filterDataProcessor_snapshot,
+    .commit = filterDataProcessor_commit,
+    .getSamples = filterDataProcessor_getSamples,
+    .warmStart = filterDataProcessor_warmStart,
+    .isWindowPartial = filterDataProcessor_isWindowPartial,
+    .recordDataTimed = filterDataProcessor_recordDataTimed,
+    .recordDataTimedInt16 = filterDataProcessor_recordDataTimedInt16,
+    .getJitter = filterDataProcessor_getJitter,
 };
@@ -9,19 +9,15 @@
 #include <math.h>
 #include <string.h>
 #include "mldataprocessor.h"
+#include "mldpkernels.h"
+#include "mldpfft.h"
 
 MldpReturn_t filterMax(const float *data_in, const int in_size, float *data_out, const int out_size) {
     if (in_size < 1 || out_size != 1) {
         return MLDP_ERROR_CONFIG;
     }
 
-    float max = data_in[0];
-    for (int i = 1; i < in_size; i++) {
-        if (data_in[i] > max) {
-            max = data_in[i];
-        }
-    }
-    *data_out = max;
+    *data_out = mldpKernel_max(data_in, in_size);
 
     return MLDP_SUCCESS;
 }
@@ -31,13 +27,7 @@ MldpReturn_t filterMin(const float *data_in, const int in_size, float *data_out,
         return MLDP_ERROR_CONFIG;
     }
 
-    float min = data_in[0];
-    for (int i = 1; i < in_size; i++) {
-        if (data_in[i] < min) {
-            min = data_in[i];
-        }
-    }
-    *data_out = min;
+    *data_out = mldpKernel_min(data_in, in_size);
 
     return MLDP_SUCCESS;
 }
@@ -47,11 +37,7 @@ MldpReturn_t filterMean(const float *data_in, const int in_size, float *data_out
         return MLDP_ERROR_CONFIG;
     }
 
-    float sum = 0;
-    for (int i = 0; i < in_size; i++) {
-        sum += data_in[i];
-    }
-    *data_out = sum / in_size;
+    *data_out = mldpKernel_mean(data_in, in_size);
 
     return MLDP_SUCCESS;
 }
@@ -62,143 +48,283 @@ MldpReturn_t filterStdDev(const float *data_in, const int in_size, float *data_o
         return MLDP_ERROR_CONFIG;
     }
 
-    float mean;
-    MldpReturn_t mean_result = filterMean(data_in, in_size, &mean, 1);
-    if (mean_result != MLDP_SUCCESS) {
-        return mean_result;
+    *data_out = mldpKernel_stdDev(data_in, in_size);
+
+    return MLDP_SUCCESS;
+}
+
+// Count the number of peaks
+// Uses a z-score algorithm over a lag window, processing one sample at a time
+// so only the lag window is kept in memory, independently of in_size
+MldpReturn_t filterPeaks(const float *data_in, const int in_size, float *data_out, const int out_size) {
+    if (in_size < MLDP_PEAKS_LAG || out_size != 1) {
+        return MLDP_ERROR_CONFIG;
     }
 
-    float std = 0;
-    float f = 0;
-    for (int i = 0; i < in_size; i++) {
-        f = data_in[i] - mean;
-        std += f * f;
+    *data_out = mldpKernel_peaks(data_in, in_size);
+
+    return MLDP_SUCCESS;
+}
+
+// Total Absolute Acceleration
+MldpReturn_t filterTotalAcc(const float *data_in, const int in_size, float *data_out, const int out_size) {
+    if (in_size < 1 || out_size != 1) {
+        return MLDP_ERROR_CONFIG;
     }
-    std /= in_size;
-    *data_out = sqrtf(std);
+
+    *data_out = mldpKernel_totalAcc(data_in, in_size);
 
     return MLDP_SUCCESS;
 }
 
-// Count the number of peaks
-// Warning! This can allocate 5x the in_size of the data in the stack
-// so ensure DEVICE_STACK_SIZE is appropriately set
-// TODO: Move to the heap, pxt automatically uses its allocator
-MldpReturn_t filterPeaks(const float *data_in, const int in_size, float *data_out, const int out_size) {
-    if (in_size < 5 || out_size != 1) {
+// Zero Crossing Rate
+MldpReturn_t filterZcr(const float *data_in, const int in_size, float *data_out, const int out_size) {
+    if (in_size < 2 || out_size != 1) {
         return MLDP_ERROR_CONFIG;
     }
 
-    const int lag = 5;
-    const float threshold = 3.5;
-    const float influence = 0.5;
-    int peaksCounter = 0;
+    *data_out = mldpKernel_zcr(data_in, in_size);
 
-    float signals[in_size];
-    float filteredY[in_size];
-    float lead_in[lag];
-    float avgFilter[in_size];
-    float stdFilter[in_size];
-    memset(signals, 0, in_size * sizeof(float));
-    memcpy(filteredY, data_in, in_size * sizeof(float));
-    memcpy(lead_in, data_in, lag * sizeof(float));
+    return MLDP_SUCCESS;
+}
 
-    float mean_lag, stdDev_lag;
-    MldpReturn_t mean_result = filterMean(lead_in, lag, &mean_lag, 1);
-    MldpReturn_t stdDev_result = filterStdDev(lead_in, lag, &stdDev_lag, 1);
-    if (stdDev_result != MLDP_SUCCESS || mean_result != MLDP_SUCCESS) {
+// Root Mean Square
+MldpReturn_t filterRms(const float *data_in, const int in_size, float *data_out, const int out_size) {
+    if (in_size < 1 || out_size != 1) {
         return MLDP_ERROR_CONFIG;
     }
 
-    avgFilter[lag - 1] = mean_lag;
-    stdFilter[lag - 1] = stdDev_lag;
+    *data_out = mldpKernel_rms(data_in, in_size);
 
-    for (int i = lag; i < in_size; i++) {
-        if (fabsf(data_in[i] - avgFilter[i - 1]) > 0.1f &&
-            fabsf(data_in[i] - avgFilter[i - 1]) > threshold * stdFilter[i - 1]
-        ) {
-            if (data_in[i] > avgFilter[i - 1]) {
-                signals[i] = +1; // positive signal
-                if (i - 1 > 0 && signals[i - 1] == 0) {
-                    peaksCounter++;
-                }
-            } else {
-                signals[i] = -1; // negative signal
+    return MLDP_SUCCESS;
+}
+
+MldpReturn_t filterPassThrough(const float *data_in, const int in_size, float *data_out, const int out_size) {
+    if (in_size > out_size) {
+        return MLDP_ERROR_CONFIG;
+    }
+
+    memcpy(data_out, data_in, in_size * sizeof(float));
+
+    return MLDP_SUCCESS;
+}
+
+/**
+ * @brief Partially reorder the data so that data[k] is the value that would
+ * be there if it was sorted, with smaller or equal values before it and
+ * larger or equal values after it.
+ */
+static float select_kth(float *data, const int size, const int k) {
+    int left = 0;
+    int right = size - 1;
+    while (left < right) {
+        // Median of three as the pivot, to avoid the worst case with sorted data
+        const int middle = left + (right - left) / 2;
+        float a = data[left], b = data[middle], c = data[right];
+        const float pivot = a < b ? (b < c ? b : (a < c ? c : a)) : (a < c ? a : (b < c ? c : b));
+        int i = left;
+        int j = right;
+        while (i <= j) {
+            while (data[i] < pivot) i++;
+            while (data[j] > pivot) j--;
+            if (i <= j) {
+                const float tmp = data[i];
+                data[i] = data[j];
+                data[j] = tmp;
+                i++;
+                j--;
             }
-            // make influence lower
-            filteredY[i] = influence * data_in[i] + (1.0f - influence) * filteredY[i - 1];
+        }
+        if (k <= j) {
+            right = j;
+        } else if (k >= i) {
+            left = i;
         } else {
-            signals[i] = 0; // no signal
-            filteredY[i] = data_in[i];
+            break;
         }
+    }
+    return data[k];
+}
 
-        // adjust the filters
-        float y_lag[lag];
-        memcpy(y_lag, &filteredY[i - lag], lag * sizeof(float));
-        filterMean(y_lag, lag, &mean_lag, 1);
-        filterStdDev(y_lag, lag, &stdDev_lag, 1);
-        avgFilter[i] = mean_lag;
-        stdFilter[i] = stdDev_lag;
+/**
+ * @brief Percentile of unsorted data, same as mldpKernel_percentileSorted().
+ * The data is partially reordered in the process.
+ */
+static float percentile_unsorted(float *data, const int size, const float percentile) {
+    const float position = percentile * (size - 1);
+    const int lower = (int)position;
+    const float fraction = position - lower;
+    const float lower_value = select_kth(data, size, lower);
+    if (fraction == 0 || lower + 1 >= size) {
+        return lower_value;
     }
-    *data_out = peaksCounter;
+    // After the selection the next rank is the smallest value above it
+    float upper_value = data[lower + 1];
+    for (int i = lower + 2; i < size; i++) {
+        if (data[i] < upper_value) upper_value = data[i];
+    }
+    return lower_value + fraction * (upper_value - lower_value);
+}
 
+/**
+ * @brief Calculate the percentiles of the window in a scratch copy, so that
+ * the window is not modified.
+ */
+static MldpReturn_t percentiles(const float *data_in, const int in_size, const float *percentile, float *values, const int count) {
+    float *scratch = (float*)malloc(in_size * sizeof(float));
+    if (scratch == NULL) {
+        return MLDP_ERROR_ALLOC;
+    }
+    memcpy(scratch, data_in, in_size * sizeof(float));
+    for (int i = 0; i < count; i++) {
+        values[i] = percentile_unsorted(scratch, in_size, percentile[i]);
+    }
+    free(scratch);
     return MLDP_SUCCESS;
 }
 
-// Total Absolute Acceleration
-MldpReturn_t filterTotalAcc(const float *data_in, const int in_size, float *data_out, const int out_size) {
+MldpReturn_t filterMedian(const float *data_in, const int in_size, float *data_out, const int out_size) {
     if (in_size < 1 || out_size != 1) {
         return MLDP_ERROR_CONFIG;
     }
 
-    float total = 0;
-    for (int i = 0; i < in_size; i++) {
-        total += fabsf(data_in[i]);
+    const float percentile[] = { 0.5f };
+    return percentiles(data_in, in_size, percentile, data_out, 1);
+}
+
+// Interquartile Range
+MldpReturn_t filterIqr(const float *data_in, const int in_size, float *data_out, const int out_size) {
+    if (in_size < 1 || out_size != 1) {
+        return MLDP_ERROR_CONFIG;
+    }
+
+    const float percentile[] = { 0.25f, 0.75f };
+    float quartiles[2];
+    MldpReturn_t result = percentiles(data_in, in_size, percentile, quartiles, 2);
+    if (result != MLDP_SUCCESS) {
+        return result;
     }
-    *data_out = total;
+    *data_out = quartiles[1] - quartiles[0];
 
     return MLDP_SUCCESS;
 }
 
-// Zero Crossing Rate
-MldpReturn_t filterZcr(const float *data_in, const int in_size, float *data_out, const int out_size) {
-    if (in_size < 2 || out_size != 1) {
+MldpReturn_t filterP10(const float *data_in, const int in_size, float *data_out, const int out_size) {
+    if (in_size < 1 || out_size != 1) {
         return MLDP_ERROR_CONFIG;
     }
 
-    int count = 0;
-    for (int i = 1; i < in_size; i++) {
-        if ((data_in[i] >= 0 && data_in[i - 1] < 0) ||
-            (data_in[i] < 0 && data_in[i - 1] >= 0)) {
-            count++;
-        }
+    const float percentile[] = { 0.1f };
+    return percentiles(data_in, in_size, percentile, data_out, 1);
+}
+
+MldpReturn_t filterP90(const float *data_in, const int in_size, float *data_out, const int out_size) {
+    if (in_size < 1 || out_size != 1) {
+        return MLDP_ERROR_CONFIG;
     }
-    *data_out = count / (in_size - 1);
+
+    const float percentile[] = { 0.9f };
+    return percentiles(data_in, in_size, percentile, data_out, 1);
+}
+
+/**
+ * @brief Add up the power of the FFT bins into bands of the same width,
+ * skipping the 0 Hz bin.
+ *
+ * @param spectrum The packed output of the real FFT, see mldpfft.h.
+ * @param scale Factor applied to the power of each bin.
+ */
+#define BAND_ENERGIES(spectrum, size, data_out, bands, scale)                   \
+    do {                                                                        \
+        const int bins = (size) / 2;                                            \
+        for (int b_i = 0; b_i < (bands); b_i++) {                               \
+            float energy = 0;                                                   \
+            const int last = 1 + (b_i + 1) * bins / (bands);                    \
+            for (int k = 1 + b_i * bins / (bands); k < last; k++) {             \
+                const float re = k == bins ? (spectrum)[1] : (spectrum)[2 * k]; \
+                const float im = k == bins ? 0.0f : (spectrum)[2 * k + 1];      \
+                energy += re * re + im * im;                                    \
+            }                                                                   \
+            (data_out)[b_i] = energy * (scale);                                 \
+        }                                                                       \
+    } while (0)
+
+// Spectral band energies
+MldpReturn_t filterBandEnergy(const float *data_in, const int in_size, float *data_out, const int out_size) {
+    const int size = mldpFft_size(in_size);
+    if (in_size < 2 || size == 0 || out_size < 1 || out_size > size / 2) {
+        return MLDP_ERROR_CONFIG;
+    }
+
+    // The FFT size can be too large for the stack, so it uses a scratch buffer
+    float *buffer = (float*)malloc(size * sizeof(float));
+    if (buffer == NULL) {
+        return MLDP_ERROR_ALLOC;
+    }
+    const float mean = mldpKernel_mean(data_in, in_size);
+    for (int i = 0; i < size; i++) {
+        buffer[i] = i < in_size ? data_in[i] - mean : 0.0f;
+    }
+    mldpFft_real(buffer, size);
+    BAND_ENERGIES(buffer, size, data_out, out_size, 1.0f / ((float)size * size));
+    free(buffer);
 
     return MLDP_SUCCESS;
 }
 
-// Root Mean Square
-MldpReturn_t filterRms(const float *data_in, const int in_size, float *data_out, const int out_size) {
-    if (in_size < 1 || out_size != 1) {
+// Spectral band energies with a fixed point FFT, the window is scaled so
+// that its largest absolute value is MLDP_FFT_Q15_MAX, half the Q15 range,
+// as the FFT needs one bit of headroom not to overflow
+MldpReturn_t filterBandEnergyQ15(const float *data_in, const int in_size, float *data_out, const int out_size) {
+    const int size = mldpFft_size(in_size);
+    if (in_size < 2 || size == 0 || out_size < 1 || out_size > size / 2) {
         return MLDP_ERROR_CONFIG;
     }
 
-    float rms = 0;
+    const float mean = mldpKernel_mean(data_in, in_size);
+    float max_abs = 0;
     for (int i = 0; i < in_size; i++) {
-        rms += data_in[i] * data_in[i];
+        const float value = fabsf(data_in[i] - mean);
+        if (value > max_abs) max_abs = value;
+    }
+    if (max_abs == 0) {
+        memset(data_out, 0, out_size * sizeof(float));
+        return MLDP_SUCCESS;
+    }
+
+    int16_t *buffer = (int16_t*)malloc(size * sizeof(int16_t));
+    if (buffer == NULL) {
+        return MLDP_ERROR_ALLOC;
+    }
+    const float to_q15 = MLDP_FFT_Q15_MAX / max_abs;
+    for (int i = 0; i < size; i++) {
+        buffer[i] = i < in_size ? (int16_t)lroundf((data_in[i] - mean) * to_q15) : 0;
     }
-    *data_out = sqrtf(rms / in_size);
+    // The Q15 output is already divided by the FFT size
+    mldpFft_realQ15(buffer, size);
+    const float from_q15 = max_abs / MLDP_FFT_Q15_MAX;
+    BAND_ENERGIES(buffer, size, data_out, out_size, from_q15 * from_q15);
+    free(buffer);
 
     return MLDP_SUCCESS;
 }
 
-MldpReturn_t filterPassThrough(const float *data_in, const int in_size, float *data_out, const int out_size) {
-    if (in_size > out_size) {
+float deriveMagnitude(const float *sample, const int dimensions) {
+    float sum_sq = 0;
+    for (int i = 0; i < dimensions; i++) {
+        sum_sq += sample[i] * sample[i];
+    }
+    return sqrtf(sum_sq);
+}
+
+// All the ML-Trainer filters calculated in a single pass through the data,
+// see the header for the order of the outputs.
+MldpReturn_t filterMlTrainer(const float *data_in, const int in_size, float *data_out, const int out_size) {
+    if (in_size < MLDP_PEAKS_LAG || out_size != MLDP_ML_TRAINER_OUT_SIZE) {
         return MLDP_ERROR_CONFIG;
     }
 
-    memcpy(data_out, data_in, in_size * sizeof(float));
+    mldpKernel_mlTrainer(data_in, in_size, data_out);
 
     return MLDP_SUCCESS;
 }
@@ -11,6 +11,7 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,31 +24,160 @@ typedef enum {
     MLDP_ERROR_CONFIG = -2,
     MLDP_ERROR_ALLOC = -3,
     MLDP_ERROR_NOINIT = -4,
+    MLDP_ERROR_NODATA = -5,
+    MLDP_ERROR_BUSY = -6,
 } MldpReturn_t;
 
+// How the samples are stored by the data processor
+typedef enum {
+    MLDP_LAYOUT_RING = 0,       // Circular buffer, copied into chronological order before filtering
+    MLDP_LAYOUT_MIRRORED = 1,   // Each sample is written twice in a 2x buffer so the window is always contiguous
+} MldpLayout_t;
+
+// How each sample value is stored by the data processor
+typedef enum {
+    MLDP_STORAGE_FLOAT = 0,     // As recorded
+    MLDP_STORAGE_INT16 = 1,     // Quantised to int16, float value = int16 value * scale
+} MldpStorage_t;
+
+typedef MldpReturn_t (*MldpFilterFn_t)(const float *data_in, const int in_size, float *data_out, const int out_size);
+
+// Statistics of a window shared between filters, see mldpstats.h
+typedef struct MldpStats_s MldpStats_t;
+typedef MldpReturn_t (*MldpStatsFilterFn_t)(const MldpStats_t *stats, float *data_out, const int out_size);
+
 typedef struct {
     const int out_size;
-    MldpReturn_t (*filter)(const float *data_in, const int in_size, float *data_out, const int out_size);
+    MldpFilterFn_t filter;
+    // Bit mask of the dimensions the filter is applied to, e.g. 0b100 only for
+    // the 3rd dimension, 0 for all of them
+    uint32_t dimensions;
+    // Optional, calculates the same output from the shared window statistics
+    // instead of the samples. Not needed for the built-in filters.
+    MldpStatsFilterFn_t stats_filter;
+    uint32_t stats;             // MLDP_STAT_* flags needed by the stats_filter
 } MlDataFilters_t;
 
+// Timing of the samples recorded with a timestamp
+typedef struct {
+    uint32_t intervals;         // Number of intervals between samples measured
+    int32_t min_deviation;      // Smallest interval minus the expected period, negative if early
+    int32_t max_deviation;      // Largest interval minus the expected period
+    float mean_deviation;       // Mean absolute difference from the expected period
+    uint32_t missed;            // Samples missing, from intervals of 1.5 periods or more
+} MldpJitter_t;
+
+// Samples ring shared by several data processors, see mldpring.h
+typedef struct MldpRing_s MldpRing_t;
+
+// Calculates a derived channel from the input dimensions of a sample
+typedef float (*MldpDeriveFn_t)(const float *sample, const int dimensions);
+
+// A chain of filters resolved at compile time, see mldppipeline.h
+typedef struct {
+    const int samples;          // Window length the pipeline has been built for
+    const int out_size;         // Number of elements produced per dimension
+    // Processes the window of one dimension, writing the output of each filter
+    // where the filter processor would place it for that dimension
+    void (*process)(const float *data_in, float *data_out, const int dimension, const int dimensions);
+} MldpPipeline_t;
+
 typedef struct {
     const int samples;          // How many samples are needed to calculated the processed output
     const int dimensions;       // How many dimensions each sample contains (e.g. x, y, z is 3 dimensions)
     const int output_length;    // Expected number elements produced by the processed output, depends on filters
     const int filter_size;      // How many filters in the *filters array
     const MlDataFilters_t *filters;
+    const bool incremental;     // Update the filters that support it as each sample is recorded
+    const MldpLayout_t layout;  // Layout of the samples buffer, trading memory for copies
+    const bool double_buffered; // Process the data from a snapshot, see MlDataProcessor_t.snapshot
+    const MldpStorage_t storage;
+    const float *scale;         // Per dimension factor to convert int16 values to float, NULL for 1.0
+    const MldpPipeline_t *pipeline; // Used instead of the filters if set, not compatible with incremental
+    // Channels calculated from each recorded sample, processed as extra
+    // dimensions after the input ones. Stored with the scale of the first
+    // input dimension when using MLDP_STORAGE_INT16.
+    const int derived_size;     // How many channels in the *derived array
+    const MldpDeriveFn_t *derived;
+    // Period of the recorded samples, when different from samples_period the
+    // samples are resampled before they are stored, see mldpresampler.h.
+    // Both in the same unit, e.g. milliseconds, 0 to disable the resampling.
+    const int input_period;
+    const int samples_period;   // Period of the samples expected by the model
+    // Number of samples, at the model period, between consecutive windows
+    // reported by isDataReady(). 0 for every new sample.
+    const int hop;
+    // Fraction of the window, from 0 to 1, that has to be recorded before the
+    // first window is ready, processed from the samples recorded so far. It's
+    // rounded up to the smallest window accepted by all the built-in filters
+    // configured, e.g. 5 samples for filterPeaks(). 0 to wait for the full
+    // window. Not compatible with a pipeline.
+    const float min_fill;
+    // Read the samples from a shared ring instead of recording them, with the
+    // window as the newest samples. The ring sets the storage, and it's not
+    // compatible with incremental, derived channels or resampling.
+    MldpRing_t *ring;
+    // Buffer of output_length floats where the processed data is written,
+    // e.g. the model input from ml_getInputBuffer(), NULL to allocate one.
+    // When double buffered it has to be left untouched from snapshot() to
+    // getProcessedData().
+    float *output_buffer;
 } MlDataProcessorConfig_t;
 
-typedef struct {
-    MldpReturn_t (*init)(const MlDataProcessorConfig_t *config);
-    void (*deinit)(void);
-    MldpReturn_t (*recordData)(const float *samples, const int elements);
-    bool (*isDataReady)(void);
-    float* (*getProcessedData)(void);
-    size_t (*getProcessedDataSize)(void);
-} MlDataProcessor_t;
+// Opaque handle to a data processor instance, created by its init()
+typedef struct MldpInstance_s *MldpHandle_t;
+
+typedef struct MlDataProcessor_s MlDataProcessor_t;
+
+struct MlDataProcessor_s {
+    // Creates a new instance, returns NULL on failure with the reason in result (if not NULL)
+    MldpHandle_t (*init)(const MlDataProcessorConfig_t *config, MldpReturn_t *result);
+    void (*deinit)(MldpHandle_t handle);
+    // Records one or more samples, elements has to be a multiple of the dimensions
+    MldpReturn_t (*recordData)(MldpHandle_t handle, const float *samples, const int elements);
+    // Records raw values, converted to float with the configured scale
+    MldpReturn_t (*recordDataInt16)(MldpHandle_t handle, const int16_t *samples, const int elements);
+    // True once per new window, after every hop of samples. If not NULL,
+    // missed_hops is set to the number of windows not reported since the
+    // last time it returned true, e.g. while a snapshot was in use.
+    bool (*isDataReady)(MldpHandle_t handle, int *missed_hops);
+    float* (*getProcessedData)(MldpHandle_t handle);
+    size_t (*getProcessedDataSize)(MldpHandle_t handle);
+    // Freeze the current data, so that getProcessedData() uses it while new
+    // samples keep being recorded. Only has an effect if double buffered.
+    // Returns MLDP_ERROR_BUSY if the previous snapshot hasn't been committed.
+    MldpReturn_t (*snapshot)(MldpHandle_t handle);
+    // Release the snapshot once the processed data is no longer needed
+    void (*commit)(MldpHandle_t handle);
+    // Copy up to max_samples of the newest recorded samples, at the model
+    // period and in chronological order, in the same format as recordData().
+    // The number of samples copied is set in samples. Returns
+    // MLDP_ERROR_CONFIG if the instance records a different number of dimensions.
+    MldpReturn_t (*getSamples)(MldpHandle_t handle, float *data_out, const int dimensions, const int max_samples, int *samples);
+    // Start a new instance with the newest samples of a previous one, so it
+    // doesn't have to wait for a full window, e.g. after changing the model.
+    // It has to be called before recording any data, and the previous
+    // instance has to record the same dimensions at the same samples period.
+    MldpReturn_t (*warmStart)(MldpHandle_t handle, const MlDataProcessor_t *previous, MldpHandle_t previous_handle);
+    // True if the processed data is calculated from a partially filled
+    // window, see MlDataProcessorConfig_t.min_fill
+    bool (*isWindowPartial)(MldpHandle_t handle);
+    // Records a single sample taken at timestamp, in the same unit as the
+    // configured periods. The samples are linearly interpolated onto a grid
+    // at the input_period (or samples_period if not set), before resampling.
+    MldpReturn_t (*recordDataTimed)(MldpHandle_t handle, const float *samples, const int elements, const uint32_t timestamp);
+    // Same as recordDataTimed() with raw values, interpolated in raw units.
+    // An instance has to record all its timed samples with the same function.
+    MldpReturn_t (*recordDataTimedInt16)(MldpHandle_t handle, const int16_t *samples, const int elements, const uint32_t timestamp);
+    // Timing statistics of the samples recorded with recordDataTimed*(),
+    // optionally starting new statistics afterwards
+    MldpReturn_t (*getJitter)(MldpHandle_t handle, MldpJitter_t *jitter, const bool reset);
+};
 
-extern MlDataProcessor_t mlDataProcessor;
+// Applies the configured filters to each dimension of the samples window
+extern const MlDataProcessor_t mlFilterDataProcessor;
+// Outputs the raw samples, in consecutive windows, e.g. for the example model 2
+extern const MlDataProcessor_t mlRawDataProcessor;
 
 MldpReturn_t filterMax(const float *data_in, const int in_size, float *data_out, const int out_size);
 MldpReturn_t filterMin(const float *data_in, const int in_size, float *data_out, const int out_size);
@@ -59,6 +189,37 @@ MldpReturn_t filterZcr(const float *data_in, const int in_size, float *data_out,
 MldpReturn_t filterRms(const float *data_in, const int in_size, float *data_out, const int out_size);
 MldpReturn_t filterPassThrough(const float *data_in, const int in_size, float *data_out, const int out_size);
 
+// Order statistics, percentiles are linearly interpolated between the closest ranks
+MldpReturn_t filterMedian(const float *data_in, const int in_size, float *data_out, const int out_size);
+MldpReturn_t filterIqr(const float *data_in, const int in_size, float *data_out, const int out_size);
+MldpReturn_t filterP10(const float *data_in, const int in_size, float *data_out, const int out_size);
+MldpReturn_t filterP90(const float *data_in, const int in_size, float *data_out, const int out_size);
+
+/**
+ * Spectral energy in out_size frequency bands of the same width, from the
+ * first frequency above 0 up to half the sampling rate. The mean is removed
+ * from the window, and it's zero padded to a power of two, up to
+ * MLDP_FFT_MAX_SIZE samples (see mldpfft.h).
+ */
+MldpReturn_t filterBandEnergy(const float *data_in, const int in_size, float *data_out, const int out_size);
+// Same as filterBandEnergy() calculated with a Q15 fixed point FFT
+MldpReturn_t filterBandEnergyQ15(const float *data_in, const int in_size, float *data_out, const int out_size);
+
+// Magnitude of the sample vector, e.g. sqrt(x² + y² + z²) for the accelerometer
+float deriveMagnitude(const float *sample, const int dimensions);
+
+/**
+ * Fused version of the ML-Trainer filters, calculated in a single pass.
+ * The output contains, in this order: max, mean, min, standard deviation,
+ * peaks, total acceleration, zero crossing rate and root mean square.
+ *
+ * The filter data processor automatically uses this filter when it finds
+ * the ML-Trainer filters in that same order, and it arranges the output per
+ * filter instead of per dimension as ML-Trainer expects.
+ */
+#define MLDP_ML_TRAINER_OUT_SIZE 8
+MldpReturn_t filterMlTrainer(const float *data_in, const int in_size, float *data_out, const int out_size);
+
 #ifdef __cplusplus
 }
 #endif
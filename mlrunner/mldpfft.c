@@ -0,0 +1,232 @@
+/**
+ * @brief In-place real FFT for the spectral data filters.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ */
+#include "mldpfft.h"
+
+// sin(2 * pi * i / MLDP_FFT_MAX_SIZE) for the first quarter of the wave
+static const float sin_table[MLDP_FFT_MAX_SIZE / 4 + 1] = {
+    0.000000000f, 0.006135885f, 0.012271538f, 0.018406730f, 0.024541229f, 0.030674803f,
+    0.036807223f, 0.042938257f, 0.049067674f, 0.055195244f, 0.061320736f, 0.067443920f,
+    0.073564564f, 0.079682438f, 0.085797312f, 0.091908956f, 0.098017140f, 0.104121634f,
+    0.110222207f, 0.116318631f, 0.122410675f, 0.128498111f, 0.134580709f, 0.140658239f,
+    0.146730474f, 0.152797185f, 0.158858143f, 0.164913120f, 0.170961889f, 0.177004220f,
+    0.183039888f, 0.189068664f, 0.195090322f, 0.201104635f, 0.207111376f, 0.213110320f,
+    0.219101240f, 0.225083911f, 0.231058108f, 0.237023606f, 0.242980180f, 0.248927606f,
+    0.254865660f, 0.260794118f, 0.266712757f, 0.272621355f, 0.278519689f, 0.284407537f,
+    0.290284677f, 0.296150888f, 0.302005949f, 0.307849640f, 0.313681740f, 0.319502031f,
+    0.325310292f, 0.331106306f, 0.336889853f, 0.342660717f, 0.348418680f, 0.354163525f,
+    0.359895037f, 0.365612998f, 0.371317194f, 0.377007410f, 0.382683432f, 0.388345047f,
+    0.393992040f, 0.399624200f, 0.405241314f, 0.410843171f, 0.416429560f, 0.422000271f,
+    0.427555093f, 0.433093819f, 0.438616239f, 0.444122145f, 0.449611330f, 0.455083587f,
+    0.460538711f, 0.465976496f, 0.471396737f, 0.476799230f, 0.482183772f, 0.487550160f,
+    0.492898192f, 0.498227667f, 0.503538384f, 0.508830143f, 0.514102744f, 0.519355990f,
+    0.524589683f, 0.529803625f, 0.534997620f, 0.540171473f, 0.545324988f, 0.550457973f,
+    0.555570233f, 0.560661576f, 0.565731811f, 0.570780746f, 0.575808191f, 0.580813958f,
+    0.585797857f, 0.590759702f, 0.595699304f, 0.600616479f, 0.605511041f, 0.610382806f,
+    0.615231591f, 0.620057212f, 0.624859488f, 0.629638239f, 0.634393284f, 0.639124445f,
+    0.643831543f, 0.648514401f, 0.653172843f, 0.657806693f, 0.662415778f, 0.666999922f,
+    0.671558955f, 0.676092704f, 0.680600998f, 0.685083668f, 0.689540545f, 0.693971461f,
+    0.698376249f, 0.702754744f, 0.707106781f, 0.711432196f, 0.715730825f, 0.720002508f,
+    0.724247083f, 0.728464390f, 0.732654272f, 0.736816569f, 0.740951125f, 0.745057785f,
+    0.749136395f, 0.753186799f, 0.757208847f, 0.761202385f, 0.765167266f, 0.769103338f,
+    0.773010453f, 0.776888466f, 0.780737229f, 0.784556597f, 0.788346428f, 0.792106577f,
+    0.795836905f, 0.799537269f, 0.803207531f, 0.806847554f, 0.810457198f, 0.814036330f,
+    0.817584813f, 0.821102515f, 0.824589303f, 0.828045045f, 0.831469612f, 0.834862875f,
+    0.838224706f, 0.841554977f, 0.844853565f, 0.848120345f, 0.851355193f, 0.854557988f,
+    0.857728610f, 0.860866939f, 0.863972856f, 0.867046246f, 0.870086991f, 0.873094978f,
+    0.876070094f, 0.879012226f, 0.881921264f, 0.884797098f, 0.887639620f, 0.890448723f,
+    0.893224301f, 0.895966250f, 0.898674466f, 0.901348847f, 0.903989293f, 0.906595705f,
+    0.909167983f, 0.911706032f, 0.914209756f, 0.916679060f, 0.919113852f, 0.921514039f,
+    0.923879533f, 0.926210242f, 0.928506080f, 0.930766961f, 0.932992799f, 0.935183510f,
+    0.937339012f, 0.939459224f, 0.941544065f, 0.943593458f, 0.945607325f, 0.947585591f,
+    0.949528181f, 0.951435021f, 0.953306040f, 0.955141168f, 0.956940336f, 0.958703475f,
+    0.960430519f, 0.962121404f, 0.963776066f, 0.965394442f, 0.966976471f, 0.968522094f,
+    0.970031253f, 0.971503891f, 0.972939952f, 0.974339383f, 0.975702130f, 0.977028143f,
+    0.978317371f, 0.979569766f, 0.980785280f, 0.981963869f, 0.983105487f, 0.984210092f,
+    0.985277642f, 0.986308097f, 0.987301418f, 0.988257568f, 0.989176510f, 0.990058210f,
+    0.990902635f, 0.991709754f, 0.992479535f, 0.993211949f, 0.993906970f, 0.994564571f,
+    0.995184727f, 0.995767414f, 0.996312612f, 0.996820299f, 0.997290457f, 0.997723067f,
+    0.998118113f, 0.998475581f, 0.998795456f, 0.999077728f, 0.999322385f, 0.999529418f,
+    0.999698819f, 0.999830582f, 0.999924702f, 0.999981175f, 1.000000000f
+};
+
+static const int16_t sin_table_q15[MLDP_FFT_MAX_SIZE / 4 + 1] = {
+    0, 201, 402, 603, 804, 1005, 1206, 1407, 1608, 1809, 2009, 2210,
+    2410, 2611, 2811, 3012, 3212, 3412, 3612, 3811, 4011, 4210, 4410, 4609,
+    4808, 5007, 5205, 5404, 5602, 5800, 5998, 6195, 6393, 6590, 6786, 6983,
+    7179, 7375, 7571, 7767, 7962, 8157, 8351, 8545, 8739, 8933, 9126, 9319,
+    9512, 9704, 9896, 10087, 10278, 10469, 10659, 10849, 11039, 11228, 11417, 11605,
+    11793, 11980, 12167, 12353, 12539, 12725, 12910, 13094, 13279, 13462, 13645, 13828,
+    14010, 14191, 14372, 14553, 14732, 14912, 15090, 15269, 15446, 15623, 15800, 15976,
+    16151, 16325, 16499, 16673, 16846, 17018, 17189, 17360, 17530, 17700, 17869, 18037,
+    18204, 18371, 18537, 18703, 18868, 19032, 19195, 19357, 19519, 19680, 19841, 20000,
+    20159, 20317, 20475, 20631, 20787, 20942, 21096, 21250, 21403, 21554, 21705, 21856,
+    22005, 22154, 22301, 22448, 22594, 22739, 22884, 23027, 23170, 23311, 23452, 23592,
+    23731, 23870, 24007, 24143, 24279, 24413, 24547, 24680, 24811, 24942, 25072, 25201,
+    25329, 25456, 25582, 25708, 25832, 25955, 26077, 26198, 26319, 26438, 26556, 26674,
+    26790, 26905, 27019, 27133, 27245, 27356, 27466, 27575, 27683, 27790, 27896, 28001,
+    28105, 28208, 28310, 28411, 28510, 28609, 28706, 28803, 28898, 28992, 29085, 29177,
+    29268, 29358, 29447, 29534, 29621, 29706, 29791, 29874, 29956, 30037, 30117, 30195,
+    30273, 30349, 30424, 30498, 30571, 30643, 30714, 30783, 30852, 30919, 30985, 31050,
+    31113, 31176, 31237, 31297, 31356, 31414, 31470, 31526, 31580, 31633, 31685, 31736,
+    31785, 31833, 31880, 31926, 31971, 32014, 32057, 32098, 32137, 32176, 32213, 32250,
+    32285, 32318, 32351, 32382, 32412, 32441, 32469, 32495, 32521, 32545, 32567, 32589,
+    32609, 32628, 32646, 32663, 32678, 32692, 32705, 32717, 32728, 32737, 32745, 32752,
+    32757, 32761, 32765, 32766, 32767
+};
+
+// Twiddle factor for an angle of 2 * pi * j / MLDP_FFT_MAX_SIZE, j < MLDP_FFT_MAX_SIZE / 2
+static inline void twiddle(const int j, float *cos_out, float *sin_out) {
+    if (j <= MLDP_FFT_MAX_SIZE / 4) {
+        *sin_out = sin_table[j];
+        *cos_out = sin_table[MLDP_FFT_MAX_SIZE / 4 - j];
+    } else {
+        *sin_out = sin_table[MLDP_FFT_MAX_SIZE / 2 - j];
+        *cos_out = -sin_table[j - MLDP_FFT_MAX_SIZE / 4];
+    }
+}
+
+static inline void twiddle_q15(const int j, int32_t *cos_out, int32_t *sin_out) {
+    if (j <= MLDP_FFT_MAX_SIZE / 4) {
+        *sin_out = sin_table_q15[j];
+        *cos_out = sin_table_q15[MLDP_FFT_MAX_SIZE / 4 - j];
+    } else {
+        *sin_out = sin_table_q15[MLDP_FFT_MAX_SIZE / 2 - j];
+        *cos_out = -sin_table_q15[j - MLDP_FFT_MAX_SIZE / 4];
+    }
+}
+
+// Reorder the interleaved complex values in bit reversed order
+#define BIT_REVERSE(type, data, points)                     \
+    for (int i = 1, j = 0; i < (points); i++) {             \
+        int bit = (points) >> 1;                            \
+        for (; j & bit; bit >>= 1) j ^= bit;                \
+        j |= bit;                                           \
+        if (i < j) {                                        \
+            type re = (data)[2 * i];                        \
+            type im = (data)[2 * i + 1];                    \
+            (data)[2 * i] = (data)[2 * j];                  \
+            (data)[2 * i + 1] = (data)[2 * j + 1];          \
+            (data)[2 * j] = re;                             \
+            (data)[2 * j + 1] = im;                         \
+        }                                                   \
+    }
+
+int mldpFft_size(const int in_size) {
+    int size = 4;
+    while (size < in_size) {
+        size <<= 1;
+    }
+    return size <= MLDP_FFT_MAX_SIZE ? size : 0;
+}
+
+void mldpFft_real(float *data, const int size) {
+    const int points = size / 2;
+
+    // Radix-2 decimation in time complex FFT of the packed samples
+    BIT_REVERSE(float, data, points);
+    for (int len = 2; len <= points; len <<= 1) {
+        const int step = MLDP_FFT_MAX_SIZE / len;
+        for (int k = 0; k < len / 2; k++) {
+            float w_cos, w_sin;
+            twiddle(k * step, &w_cos, &w_sin);
+            for (int i = k; i < points; i += len) {
+                float *a = &data[2 * i];
+                float *b = &data[2 * (i + len / 2)];
+                const float t_re = w_cos * b[0] + w_sin * b[1];
+                const float t_im = w_cos * b[1] - w_sin * b[0];
+                b[0] = a[0] - t_re;
+                b[1] = a[1] - t_im;
+                a[0] += t_re;
+                a[1] += t_im;
+            }
+        }
+    }
+
+    // Split into the spectrum of the real signal, X[k] and X[N/2 - k]
+    // are calculated together from Z[k] and Z[N/2 - k]
+    const float z0_re = data[0];
+    const float z0_im = data[1];
+    data[0] = z0_re + z0_im;
+    data[1] = z0_re - z0_im;
+    const int step = MLDP_FFT_MAX_SIZE / size;
+    for (int k = 1; k <= points / 2; k++) {
+        float *z_k = &data[2 * k];
+        float *z_nk = &data[2 * (points - k)];
+        // Even and odd samples spectrums, times 2
+        const float even_re = z_k[0] + z_nk[0];
+        const float even_im = z_k[1] - z_nk[1];
+        const float odd_re = z_k[1] + z_nk[1];
+        const float odd_im = z_nk[0] - z_k[0];
+        float w_cos, w_sin;
+        twiddle(k * step, &w_cos, &w_sin);
+        const float t_re = w_cos * odd_re + w_sin * odd_im;
+        const float t_im = w_cos * odd_im - w_sin * odd_re;
+        z_k[0] = 0.5f * (even_re + t_re);
+        z_k[1] = 0.5f * (even_im + t_im);
+        if (k != points - k) {
+            z_nk[0] = 0.5f * (even_re - t_re);
+            z_nk[1] = -0.5f * (even_im - t_im);
+        }
+    }
+}
+
+void mldpFft_realQ15(int16_t *data, const int size) {
+    const int points = size / 2;
+
+    // Each butterfly stage is scaled by 1/2, so the output is Z / points.
+    // With the input within MLDP_FFT_Q15_MAX the complex magnitudes stay
+    // below sqrt(2) * MLDP_FFT_Q15_MAX, so the sums before the shift fit
+    // in 17 bits and the shifted values in int16_t.
+    BIT_REVERSE(int16_t, data, points);
+    for (int len = 2; len <= points; len <<= 1) {
+        const int step = MLDP_FFT_MAX_SIZE / len;
+        for (int k = 0; k < len / 2; k++) {
+            int32_t w_cos, w_sin;
+            twiddle_q15(k * step, &w_cos, &w_sin);
+            for (int i = k; i < points; i += len) {
+                int16_t *a = &data[2 * i];
+                int16_t *b = &data[2 * (i + len / 2)];
+                const int32_t t_re = (w_cos * b[0] + w_sin * b[1]) >> 15;
+                const int32_t t_im = (w_cos * b[1] - w_sin * b[0]) >> 15;
+                const int32_t a_re = a[0];
+                const int32_t a_im = a[1];
+                a[0] = (int16_t)((a_re + t_re) >> 1);
+                a[1] = (int16_t)((a_im + t_im) >> 1);
+                b[0] = (int16_t)((a_re - t_re) >> 1);
+                b[1] = (int16_t)((a_im - t_im) >> 1);
+            }
+        }
+    }
+
+    // Same split as the float version, with an extra 1/2 so that the
+    // output is X / size
+    const int32_t z0_re = data[0];
+    const int32_t z0_im = data[1];
+    data[0] = (int16_t)((z0_re + z0_im) >> 1);
+    data[1] = (int16_t)((z0_re - z0_im) >> 1);
+    const int step = MLDP_FFT_MAX_SIZE / size;
+    for (int k = 1; k <= points / 2; k++) {
+        int16_t *z_k = &data[2 * k];
+        int16_t *z_nk = &data[2 * (points - k)];
+        const int32_t even_re = z_k[0] + z_nk[0];
+        const int32_t even_im = z_k[1] - z_nk[1];
+        const int32_t odd_re = z_k[1] + z_nk[1];
+        const int32_t odd_im = z_nk[0] - z_k[0];
+        int32_t w_cos, w_sin;
+        twiddle_q15(k * step, &w_cos, &w_sin);
+        // The sums of two values can take 17 bits, so the products need 64
+        const int32_t t_re = (int32_t)(((int64_t)w_cos * odd_re + (int64_t)w_sin * odd_im) >> 15);
+        const int32_t t_im = (int32_t)(((int64_t)w_cos * odd_im - (int64_t)w_sin * odd_re) >> 15);
+        z_k[0] = (int16_t)((even_re + t_re) >> 2);
+        z_k[1] = (int16_t)((even_im + t_im) >> 2);
+        if (k != points - k) {
+            z_nk[0] = (int16_t)((even_re - t_re) >> 2);
+            z_nk[1] = (int16_t)(-((even_im - t_im) >> 2));
+        }
+    }
+}
@@ -0,0 +1,49 @@
+/**
+ * @brief In-place real FFT for the spectral data filters.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ *
+ * @details
+ * A real signal of N samples is transformed as a complex signal of N/2
+ * samples, made of the even samples as the real part and the odd samples as
+ * the imaginary part, and the result is then split into the spectrum of the
+ * real signal. The twiddle factors come from a quarter wave sine table, so
+ * no trigonometric functions are called.
+ *
+ * The output is in the same buffer, packed as:
+ *   data[0] = X[0].re, data[1] = X[N/2].re,
+ *   data[2k] = X[k].re, data[2k + 1] = X[k].im for 0 < k < N/2
+ *
+ * The Q15 version scales the output by 1/N. A butterfly adds a value to
+ * one rotated by the twiddle factor, which can be up to sqrt(2) times its
+ * largest component, so the input has to be within +/-MLDP_FFT_Q15_MAX
+ * (one bit of headroom) for the butterflies not to overflow.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The FFT size has to be a power of two, from 4 to MLDP_FFT_MAX_SIZE
+#define MLDP_FFT_MAX_SIZE 1024
+
+// Largest absolute input value for mldpFft_realQ15()
+#define MLDP_FFT_Q15_MAX 16384
+
+/**
+ * @return The FFT size to fit in_size samples, or 0 if it's too big.
+ */
+int mldpFft_size(const int in_size);
+
+void mldpFft_real(float *data, const int size);
+
+void mldpFft_realQ15(int16_t *data, const int size);
+
+#ifdef __cplusplus
+}
+#endif
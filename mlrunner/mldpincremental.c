@@ -0,0 +1,256 @@
+/**
+ * @brief Running state to calculate some of the data filters incrementally.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ */
+#include <math.h>
+#include <string.h>
+#include "mldpincremental.h"
+#include "mldpkernels.h"
+
+
+static inline bool is_zero_crossing(const float previous, const float current) {
+    return (current >= 0 && previous < 0) || (current < 0 && previous >= 0);
+}
+
+static inline MldpDequeItem_t* deque_at(MldpDeque_t *deque, const int window, const int i) {
+    return &deque->items[(deque->head + i) % window];
+}
+
+/**
+ * @brief Add a value to the back of a monotonic deque, dropping the values
+ * that can no longer be the front (max, or min if is_min set) of the window.
+ */
+static void deque_push(MldpDeque_t *deque, const int window, const float value, const unsigned int seq, const bool is_min) {
+    // Expire the values that have left the window
+    while (deque->count > 0 && (seq - deque_at(deque, window, 0)->seq) >= (unsigned int)window) {
+        deque->head = (deque->head + 1) % window;
+        deque->count--;
+    }
+    // Values in the back that are dominated by the new value are dropped
+    while (deque->count > 0) {
+        const float back = deque_at(deque, window, deque->count - 1)->value;
+        if ((is_min && back < value) || (!is_min && back > value)) {
+            break;
+        }
+        deque->count--;
+    }
+    MldpDequeItem_t *item = deque_at(deque, window, deque->count);
+    item->value = value;
+    item->seq = seq;
+    deque->count++;
+}
+
+static inline bool is_order_statistic(MldpFilterFn_t filter) {
+    return filter == filterMedian ||
+           filter == filterIqr ||
+           filter == filterP10 ||
+           filter == filterP90;
+}
+
+// Index of the first value in the sorted window that is not less than value
+static int sorted_lower_bound(const float *sorted, const int count, const float value) {
+    int low = 0;
+    int high = count;
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        if (sorted[middle] < value) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief Replace a value of the sorted window, only moving the values in
+ * between the removed and the inserted positions.
+ *
+ * @param count Number of values in the window, including the one removed.
+ */
+static void sorted_replace(float *sorted, const int count, const float removed, const float value) {
+    int i = sorted_lower_bound(sorted, count, removed);
+    // The removed value has to be in the window, so this is only a safeguard
+    if (i >= count || sorted[i] != removed) {
+        i = count - 1;
+    }
+    if (value > sorted[i]) {
+        while (i + 1 < count && sorted[i + 1] < value) {
+            sorted[i] = sorted[i + 1];
+            i++;
+        }
+    } else {
+        while (i > 0 && sorted[i - 1] > value) {
+            sorted[i] = sorted[i - 1];
+            i--;
+        }
+    }
+    sorted[i] = value;
+}
+
+static void sorted_insert(float *sorted, const int count, const float value) {
+    const int i = sorted_lower_bound(sorted, count, value);
+    memmove(&sorted[i + 1], &sorted[i], (count - i) * sizeof(float));
+    sorted[i] = value;
+}
+
+bool mldpIncremental_isSupported(MldpFilterFn_t filter) {
+    return filter == filterMax ||
+           filter == filterMin ||
+           filter == filterMean ||
+           filter == filterStdDev ||
+           filter == filterTotalAcc ||
+           filter == filterZcr ||
+           filter == filterRms ||
+           is_order_statistic(filter);
+}
+
+MldpReturn_t mldpIncremental_init(MldpIncremental_t *inc, const int window, const MlDataFilters_t *filters, const int filter_size) {
+    memset(inc, 0, sizeof(MldpIncremental_t));
+    if (window <= 0) {
+        return MLDP_ERROR_CONFIG;
+    }
+    inc->window = window;
+
+    for (int i = 0; i < filter_size; i++) {
+        if (filters[i].filter == filterMax) inc->track_max = true;
+        if (filters[i].filter == filterMin) inc->track_min = true;
+        if (is_order_statistic(filters[i].filter) && inc->sorted == NULL) {
+            inc->sorted = (float*)malloc(window * sizeof(float));
+            if (inc->sorted == NULL) {
+                mldpIncremental_deinit(inc);
+                return MLDP_ERROR_ALLOC;
+            }
+        }
+    }
+    if (inc->track_max) {
+        inc->max.items = (MldpDequeItem_t*)malloc(window * sizeof(MldpDequeItem_t));
+        if (inc->max.items == NULL) {
+            mldpIncremental_deinit(inc);
+            return MLDP_ERROR_ALLOC;
+        }
+    }
+    if (inc->track_min) {
+        inc->min.items = (MldpDequeItem_t*)malloc(window * sizeof(MldpDequeItem_t));
+        if (inc->min.items == NULL) {
+            mldpIncremental_deinit(inc);
+            return MLDP_ERROR_ALLOC;
+        }
+    }
+
+    return MLDP_SUCCESS;
+}
+
+void mldpIncremental_deinit(MldpIncremental_t *inc) {
+    free(inc->max.items);
+    free(inc->min.items);
+    free(inc->sorted);
+    memset(inc, 0, sizeof(MldpIncremental_t));
+}
+
+void mldpIncremental_push(MldpIncremental_t *inc, const float value, const float oldest, const float next_oldest) {
+    if (inc->track_max) deque_push(&inc->max, inc->window, value, inc->seq, false);
+    if (inc->track_min) deque_push(&inc->min, inc->window, value, inc->seq, true);
+    inc->seq++;
+
+    if (inc->count > 0 && is_zero_crossing(inc->newest, value)) {
+        inc->zero_crossings++;
+    }
+    inc->newest = value;
+
+    inc->sum += value;
+    inc->sum_abs += fabsf(value);
+    inc->sum_sq += value * value;
+
+    if (inc->sorted != NULL) {
+        if (inc->count < inc->window) {
+            sorted_insert(inc->sorted, inc->count, value);
+        } else {
+            sorted_replace(inc->sorted, inc->count, oldest, value);
+        }
+    }
+
+    if (inc->count < inc->window) {
+        // Growing window, standard Welford update
+        inc->count++;
+        const float delta = value - inc->mean;
+        inc->mean += delta / inc->count;
+        inc->m2 += delta * (value - inc->mean);
+    } else {
+        // Sliding window, the oldest sample is replaced by the new one
+        inc->sum -= oldest;
+        inc->sum_abs -= fabsf(oldest);
+        inc->sum_sq -= oldest * oldest;
+        if (inc->window > 1 && is_zero_crossing(oldest, next_oldest)) {
+            inc->zero_crossings--;
+        }
+        const float mean_old = inc->mean;
+        const float delta = value - oldest;
+        inc->mean += delta / inc->count;
+        inc->m2 += delta * (value - inc->mean + oldest - mean_old);
+    }
+}
+
+void mldpIncremental_reseed(MldpIncremental_t *inc, const float *window) {
+    inc->count = inc->window;
+    inc->sum = 0;
+    inc->sum_abs = 0;
+    inc->sum_sq = 0;
+    for (int i = 0; i < inc->window; i++) {
+        inc->sum += window[i];
+        inc->sum_abs += fabsf(window[i]);
+        inc->sum_sq += window[i] * window[i];
+    }
+    inc->mean = inc->sum / inc->window;
+    inc->m2 = 0;
+    for (int i = 0; i < inc->window; i++) {
+        const float f = window[i] - inc->mean;
+        inc->m2 += f * f;
+    }
+}
+
+MldpReturn_t mldpIncremental_output(const MldpIncremental_t *inc, MldpFilterFn_t filter, float *data_out, const int out_size) {
+    if (inc->count < 1 || out_size != 1) {
+        return MLDP_ERROR_CONFIG;
+    }
+
+    if (filter == filterMax) {
+        if (!inc->track_max) return MLDP_ERROR_CONFIG;
+        *data_out = inc->max.items[inc->max.head].value;
+    } else if (filter == filterMin) {
+        if (!inc->track_min) return MLDP_ERROR_CONFIG;
+        *data_out = inc->min.items[inc->min.head].value;
+    } else if (filter == filterMean) {
+        *data_out = inc->sum / inc->count;
+    } else if (filter == filterStdDev) {
+        // Rounding errors could make it slightly negative when the variance is ~0
+        *data_out = inc->m2 > 0 ? sqrtf(inc->m2 / inc->count) : 0.0f;
+    } else if (filter == filterTotalAcc) {
+        *data_out = inc->sum_abs;
+    } else if (filter == filterZcr) {
+        if (inc->count < 2) return MLDP_ERROR_CONFIG;
+        // Integer division to match filterZcr()
+        *data_out = inc->zero_crossings / (inc->count - 1);
+    } else if (filter == filterRms) {
+        *data_out = inc->sum_sq > 0 ? sqrtf(inc->sum_sq / inc->count) : 0.0f;
+    } else if (is_order_statistic(filter)) {
+        if (inc->sorted == NULL) return MLDP_ERROR_CONFIG;
+        if (filter == filterMedian) {
+            *data_out = mldpKernel_percentileSorted(inc->sorted, inc->count, 0.5f);
+        } else if (filter == filterIqr) {
+            *data_out = mldpKernel_percentileSorted(inc->sorted, inc->count, 0.75f) -
+                        mldpKernel_percentileSorted(inc->sorted, inc->count, 0.25f);
+        } else if (filter == filterP10) {
+            *data_out = mldpKernel_percentileSorted(inc->sorted, inc->count, 0.1f);
+        } else {
+            *data_out = mldpKernel_percentileSorted(inc->sorted, inc->count, 0.9f);
+        }
+    } else {
+        return MLDP_ERROR_CONFIG;
+    }
+
+    return MLDP_SUCCESS;
+}
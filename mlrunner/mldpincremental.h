@@ -0,0 +1,104 @@
+/**
+ * @brief Running state to calculate some of the data filters incrementally.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ *
+ * @details
+ * Each instance tracks a single dimension of a sliding window of samples.
+ * The state is updated as each new sample is recorded, so that the output
+ * of the supported filters can be retrieved without iterating through the
+ * whole window again.
+ *
+ * Supported filters: filterMax, filterMin, filterMean, filterStdDev,
+ * filterTotalAcc, filterZcr, filterRms, filterMedian, filterIqr, filterP10
+ * and filterP90.
+ *
+ * The order statistics keep the window sorted, so each new sample costs a
+ * binary search and moving the values between the oldest sample and the new
+ * one, and any percentile can then be read in constant time.
+ */
+#pragma once
+
+#include "mldataprocessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    float value;
+    unsigned int seq;           // Sequence number of the sample, used to expire it from the window
+} MldpDequeItem_t;
+
+// Monotonic double-ended queue, the front is always the max (or min) of the window
+typedef struct {
+    MldpDequeItem_t *items;     // Circular buffer with capacity for a full window
+    int head;
+    int count;
+} MldpDeque_t;
+
+typedef struct {
+    int window;                 // Number of samples in a full window
+    int count;                  // Number of samples currently in the window
+    unsigned int seq;           // Sequence number for the next sample
+    bool track_max;
+    bool track_min;
+    MldpDeque_t max;
+    MldpDeque_t min;
+    float *sorted;              // Window values in ascending order, NULL if not needed
+    float sum;
+    float sum_abs;
+    float sum_sq;
+    float mean;                 // Welford running mean
+    float m2;                   // Welford running sum of squared differences from the mean
+    int zero_crossings;
+    float newest;
+} MldpIncremental_t;
+
+/**
+ * @brief Check if a filter can be calculated incrementally.
+ */
+bool mldpIncremental_isSupported(MldpFilterFn_t filter);
+
+/**
+ * @brief Initialise the state for a window, only allocating what is needed
+ * by the filters provided.
+ */
+MldpReturn_t mldpIncremental_init(MldpIncremental_t *inc, const int window, const MlDataFilters_t *filters, const int filter_size);
+
+void mldpIncremental_deinit(MldpIncremental_t *inc);
+
+/**
+ * @brief Add a new sample to the window.
+ *
+ * When the window is already full the oldest sample is dropped, so the
+ * caller has to provide it together with the sample that follows it.
+ *
+ * @param value The new sample.
+ * @param oldest The oldest sample in the window, ignored if not full.
+ * @param next_oldest The sample after the oldest, ignored if not full.
+ */
+void mldpIncremental_push(MldpIncremental_t *inc, const float value, const float oldest, const float next_oldest);
+
+/**
+ * @brief Recalculate the running sums from the full window contents, to
+ * discard any floating point error accumulated by adding and removing
+ * samples.
+ *
+ * @param window The samples in the window in chronological order.
+ */
+void mldpIncremental_reseed(MldpIncremental_t *inc, const float *window);
+
+/**
+ * @brief Get the output for a filter from the current window state.
+ *
+ * @return MLDP_ERROR_CONFIG if the filter is not supported or the window
+ *         doesn't contain enough samples for it.
+ */
+MldpReturn_t mldpIncremental_output(const MldpIncremental_t *inc, MldpFilterFn_t filter, float *data_out, const int out_size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,240 @@
+/**
+ * @brief Inline kernels with the calculations behind the data filters.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ *
+ * @details
+ * These are the filter calculations without any validation of the
+ * arguments, shared by the filter functions in mldataprocessor.c, which
+ * validate them at runtime, and by the pipelines in mldppipeline.h, which
+ * validate them at compile time.
+ */
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Peaks detection parameters
+#define MLDP_PEAKS_LAG 5
+#define MLDP_PEAKS_THRESHOLD 3.5f
+#define MLDP_PEAKS_INFLUENCE 0.5f
+
+// Peaks detection state for a single pass through the data, one sample at a time
+typedef struct {
+    float filtered[MLDP_PEAKS_LAG + 1]; // Circular buffer with the last filtered values
+    int count;                          // Number of samples pushed so far
+    float avg;
+    float std;
+    int prev_signal;
+    int peaks;
+} MldpPeaksDetector_t;
+
+static inline float mldpKernel_max(const float *data_in, const int in_size) {
+    float max = data_in[0];
+    for (int i = 1; i < in_size; i++) {
+        if (data_in[i] > max) {
+            max = data_in[i];
+        }
+    }
+    return max;
+}
+
+static inline float mldpKernel_min(const float *data_in, const int in_size) {
+    float min = data_in[0];
+    for (int i = 1; i < in_size; i++) {
+        if (data_in[i] < min) {
+            min = data_in[i];
+        }
+    }
+    return min;
+}
+
+static inline float mldpKernel_mean(const float *data_in, const int in_size) {
+    float sum = 0;
+    for (int i = 0; i < in_size; i++) {
+        sum += data_in[i];
+    }
+    return sum / in_size;
+}
+
+// Standard Deviation
+static inline float mldpKernel_stdDev(const float *data_in, const int in_size) {
+    const float mean = mldpKernel_mean(data_in, in_size);
+    float std = 0;
+    float f = 0;
+    for (int i = 0; i < in_size; i++) {
+        f = data_in[i] - mean;
+        std += f * f;
+    }
+    std /= in_size;
+    return sqrtf(std);
+}
+
+// Mean and standard deviation of the MLDP_PEAKS_LAG filtered values before
+// the newest one, calculated in the same order as the mean & stdDev kernels
+static inline void mldpKernel_peaksUpdateStats(MldpPeaksDetector_t *pd, const int first) {
+    float sum = 0;
+    for (int i = 0; i < MLDP_PEAKS_LAG; i++) {
+        sum += pd->filtered[(first + i) % (MLDP_PEAKS_LAG + 1)];
+    }
+    const float mean = sum / MLDP_PEAKS_LAG;
+    float std = 0;
+    for (int i = 0; i < MLDP_PEAKS_LAG; i++) {
+        const float f = pd->filtered[(first + i) % (MLDP_PEAKS_LAG + 1)] - mean;
+        std += f * f;
+    }
+    std /= MLDP_PEAKS_LAG;
+    pd->avg = mean;
+    pd->std = sqrtf(std);
+}
+
+static inline void mldpKernel_peaksPush(MldpPeaksDetector_t *pd, const float value) {
+    const int i = pd->count++;
+    if (i < MLDP_PEAKS_LAG) {
+        // Lead-in, the stats start with the first MLDP_PEAKS_LAG samples
+        pd->filtered[i] = value;
+        if (i == MLDP_PEAKS_LAG - 1) {
+            mldpKernel_peaksUpdateStats(pd, 0);
+        }
+        return;
+    }
+
+    const float prev_filtered = pd->filtered[(i - 1) % (MLDP_PEAKS_LAG + 1)];
+    float filtered = value;
+    int signal = 0;
+    if (fabsf(value - pd->avg) > 0.1f &&
+        fabsf(value - pd->avg) > MLDP_PEAKS_THRESHOLD * pd->std
+    ) {
+        if (value > pd->avg) {
+            signal = +1; // positive signal
+            if (pd->prev_signal == 0) {
+                pd->peaks++;
+            }
+        } else {
+            signal = -1; // negative signal
+        }
+        // make influence lower
+        filtered = MLDP_PEAKS_INFLUENCE * value + (1.0f - MLDP_PEAKS_INFLUENCE) * prev_filtered;
+    }
+    pd->prev_signal = signal;
+    pd->filtered[i % (MLDP_PEAKS_LAG + 1)] = filtered;
+
+    // adjust the filters
+    mldpKernel_peaksUpdateStats(pd, i - MLDP_PEAKS_LAG);
+}
+
+// Count the number of peaks, needs at least MLDP_PEAKS_LAG samples
+static inline float mldpKernel_peaks(const float *data_in, const int in_size) {
+    MldpPeaksDetector_t peaks = { { 0 }, 0, 0, 0, 0, 0 };
+    for (int i = 0; i < in_size; i++) {
+        mldpKernel_peaksPush(&peaks, data_in[i]);
+    }
+    return peaks.peaks;
+}
+
+// Total Absolute Acceleration
+static inline float mldpKernel_totalAcc(const float *data_in, const int in_size) {
+    float total = 0;
+    for (int i = 0; i < in_size; i++) {
+        total += fabsf(data_in[i]);
+    }
+    return total;
+}
+
+// Zero Crossing Rate, needs at least 2 samples
+static inline float mldpKernel_zcr(const float *data_in, const int in_size) {
+    int count = 0;
+    for (int i = 1; i < in_size; i++) {
+        if ((data_in[i] >= 0 && data_in[i - 1] < 0) ||
+            (data_in[i] < 0 && data_in[i - 1] >= 0)) {
+            count++;
+        }
+    }
+    return count / (in_size - 1);
+}
+
+// Root Mean Square
+static inline float mldpKernel_rms(const float *data_in, const int in_size) {
+    float rms = 0;
+    for (int i = 0; i < in_size; i++) {
+        rms += data_in[i] * data_in[i];
+    }
+    return sqrtf(rms / in_size);
+}
+
+/**
+ * @brief Percentile of a sorted window, with linear interpolation between
+ * the closest ranks.
+ *
+ * @param percentile From 0 to 1.
+ */
+static inline float mldpKernel_percentileSorted(const float *sorted, const int in_size, const float percentile) {
+    const float position = percentile * (in_size - 1);
+    const int lower = (int)position;
+    const float fraction = position - lower;
+    if (fraction == 0 || lower + 1 >= in_size) {
+        return sorted[lower];
+    }
+    return sorted[lower] + fraction * (sorted[lower + 1] - sorted[lower]);
+}
+
+// Convert a value to int16 with the inverse of the scale of its dimension,
+// rounded to the nearest integer and clamped to the int16 range
+static inline int16_t mldpKernel_quantise(const float value, const float inverse_scale) {
+    float scaled = value * inverse_scale;
+    scaled = scaled > INT16_MAX ? INT16_MAX : (scaled < INT16_MIN ? INT16_MIN : scaled);
+    return (int16_t)(scaled >= 0 ? scaled + 0.5f : scaled - 0.5f);
+}
+
+// All the ML-Trainer filters in a single pass, needs at least MLDP_PEAKS_LAG
+// samples and outputs 8 values in the order documented for filterMlTrainer()
+static inline void mldpKernel_mlTrainer(const float *data_in, const int in_size, float *data_out) {
+    MldpPeaksDetector_t peaks = { { 0 }, 0, 0, 0, 0, 0 };
+    float max = data_in[0];
+    float min = data_in[0];
+    float sum = 0;
+    float total = 0;
+    float rms = 0;
+    float mean = 0;
+    float m2 = 0;
+    int zero_crossings = 0;
+    for (int i = 0; i < in_size; i++) {
+        const float value = data_in[i];
+        if (value > max) max = value;
+        if (value < min) min = value;
+        sum += value;
+        total += fabsf(value);
+        rms += value * value;
+        // Welford's online algorithm for the standard deviation
+        const float delta = value - mean;
+        mean += delta / (i + 1);
+        m2 += delta * (value - mean);
+        if (i > 0 && (
+            (value >= 0 && data_in[i - 1] < 0) ||
+            (value < 0 && data_in[i - 1] >= 0))
+        ) {
+            zero_crossings++;
+        }
+        mldpKernel_peaksPush(&peaks, value);
+    }
+
+    data_out[0] = max;
+    data_out[1] = sum / in_size;
+    data_out[2] = min;
+    data_out[3] = sqrtf(m2 / in_size);
+    data_out[4] = peaks.peaks;
+    data_out[5] = total;
+    data_out[6] = zero_crossings / (in_size - 1);
+    data_out[7] = sqrtf(rms / in_size);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,158 @@
+/**
+ * @brief Filter pipelines specialised at compile time, for C++ only.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ *
+ * @details
+ * A pipeline takes the window length and the list of filters as template
+ * parameters, so that the filters are called directly through their inline
+ * kernels instead of through function pointers, and the checks of the window
+ * and output sizes happen at compile time with static_assert.
+ *
+ * The output has the same layout as the filter data processor output, so a
+ * pipeline can be set in MlDataProcessorConfig_t.pipeline instead of the
+ * filters array:
+ *
+ *     typedef MldpPipeline<80, filterMax, filterMin, filterRms> MyPipeline;
+ *     const MlDataProcessorConfig_t config = {
+ *         .samples = MyPipeline::samples,
+ *         .dimensions = 3,
+ *         .output_length = MyPipeline::out_size * 3,
+ *         ...
+ *         .pipeline = &mldpPipeline<MyPipeline>(),
+ *     };
+ */
+#pragma once
+
+#ifdef __cplusplus
+
+#include "mldataprocessor.h"
+#include "mldpkernels.h"
+
+template <MldpFilterFn_t Filter>
+struct MldpAlwaysFalse {
+    static constexpr bool value = false;
+};
+
+/**
+ * @brief Compile time information and inline kernel for each filter.
+ *
+ * Only the built-in filters have a kernel, any other filter has to use the
+ * filters array of the data processor.
+ */
+template <MldpFilterFn_t Filter>
+struct MldpKernel {
+    static_assert(MldpAlwaysFalse<Filter>::value, "Filter not supported in a pipeline");
+};
+
+#define MLDP_PIPELINE_KERNEL(filter_fn, min_in_size, kernel_fn)                     \
+    template <>                                                                     \
+    struct MldpKernel<filter_fn> {                                                  \
+        static constexpr int min_samples = min_in_size;                             \
+        static constexpr int outSize(const int) { return 1; }                       \
+        static inline void run(const float *data_in, const int in_size, float *data_out) { \
+            *data_out = kernel_fn(data_in, in_size);                                \
+        }                                                                           \
+    };
+
+MLDP_PIPELINE_KERNEL(filterMax, 1, mldpKernel_max)
+MLDP_PIPELINE_KERNEL(filterMin, 1, mldpKernel_min)
+MLDP_PIPELINE_KERNEL(filterMean, 1, mldpKernel_mean)
+MLDP_PIPELINE_KERNEL(filterStdDev, 1, mldpKernel_stdDev)
+MLDP_PIPELINE_KERNEL(filterPeaks, MLDP_PEAKS_LAG, mldpKernel_peaks)
+MLDP_PIPELINE_KERNEL(filterTotalAcc, 1, mldpKernel_totalAcc)
+MLDP_PIPELINE_KERNEL(filterZcr, 2, mldpKernel_zcr)
+MLDP_PIPELINE_KERNEL(filterRms, 1, mldpKernel_rms)
+
+#undef MLDP_PIPELINE_KERNEL
+
+template <>
+struct MldpKernel<filterPassThrough> {
+    static constexpr int min_samples = 1;
+    static constexpr int outSize(const int samples) { return samples; }
+    static inline void run(const float *data_in, const int in_size, float *data_out) {
+        memcpy(data_out, data_in, in_size * sizeof(float));
+    }
+};
+
+/**
+ * @brief Applies the filters in order, each one writing its output after
+ * the output of the previous filters for all the dimensions.
+ */
+template <int Samples, MldpFilterFn_t... Filters>
+struct MldpPipelineStep;
+
+template <int Samples>
+struct MldpPipelineStep<Samples> {
+    static constexpr int out_size = 0;
+    static inline void run(const float *, float *, const int, const int) { }
+};
+
+template <int Samples, MldpFilterFn_t Filter, MldpFilterFn_t... Rest>
+struct MldpPipelineStep<Samples, Filter, Rest...> {
+    typedef MldpKernel<Filter> Kernel;
+    static_assert(Samples >= Kernel::min_samples, "Window too short for a filter in the pipeline");
+
+    static constexpr int filter_out_size = Kernel::outSize(Samples);
+    static constexpr int out_size = filter_out_size + MldpPipelineStep<Samples, Rest...>::out_size;
+
+    static inline void run(const float *data_in, float *data_out, const int dimension, const int dimensions) {
+        Kernel::run(data_in, Samples, &data_out[dimension * filter_out_size]);
+        MldpPipelineStep<Samples, Rest...>::run(
+            data_in, &data_out[filter_out_size * dimensions], dimension, dimensions);
+    }
+};
+
+/**
+ * @brief A pipeline with a window of Samples and the list of Filters.
+ */
+template <int Samples, MldpFilterFn_t... Filters>
+struct MldpPipeline {
+    static_assert(Samples > 0, "The pipeline window needs at least one sample");
+    static_assert(sizeof...(Filters) > 0, "The pipeline needs at least one filter");
+
+    static constexpr int samples = Samples;
+    static constexpr int out_size = MldpPipelineStep<Samples, Filters...>::out_size;
+
+    static void process(const float *data_in, float *data_out, const int dimension, const int dimensions) {
+        MldpPipelineStep<Samples, Filters...>::run(data_in, data_out, dimension, dimensions);
+    }
+};
+
+/**
+ * @brief The ML-Trainer filters in their usual order are calculated with the
+ * fused kernel in a single pass through the window.
+ */
+template <int Samples>
+struct MldpPipeline<Samples, filterMax, filterMean, filterMin, filterStdDev,
+                    filterPeaks, filterTotalAcc, filterZcr, filterRms> {
+    static_assert(Samples >= MLDP_PEAKS_LAG, "Window too short for a filter in the pipeline");
+
+    static constexpr int samples = Samples;
+    static constexpr int out_size = MLDP_ML_TRAINER_OUT_SIZE;
+
+    static void process(const float *data_in, float *data_out, const int dimension, const int dimensions) {
+        float fused_output[MLDP_ML_TRAINER_OUT_SIZE];
+        mldpKernel_mlTrainer(data_in, Samples, fused_output);
+        for (int i = 0; i < MLDP_ML_TRAINER_OUT_SIZE; i++) {
+            data_out[i * dimensions + dimension] = fused_output[i];
+        }
+    }
+};
+
+/**
+ * @return The pipeline description to use in MlDataProcessorConfig_t.
+ */
+template <typename Pipeline>
+const MldpPipeline_t& mldpPipeline() {
+    static const MldpPipeline_t pipeline = {
+        Pipeline::samples,
+        Pipeline::out_size,
+        Pipeline::process,
+    };
+    return pipeline;
+}
+
+#endif
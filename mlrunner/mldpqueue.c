@@ -0,0 +1,97 @@
+/**
+ * @brief Lock-free queue to record samples from an interrupt.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ *
+ * @details
+ * The indexes are free running counters, wrapping around at 2^32, and the
+ * position in the buffer is the counter modulo the capacity. The sample is
+ * written before the head is released, and read before the tail is
+ * released, so each side only sees complete samples.
+ */
+#include <string.h>
+#include "mldpqueue.h"
+
+#define LOAD_ACQUIRE(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+
+
+MldpReturn_t mldpQueue_init(MldpQueue_t *queue, const int dimensions, const int capacity) {
+    memset(queue, 0, sizeof(MldpQueue_t));
+    if (dimensions <= 0 || capacity <= 0 || capacity > (1 << 16)) {
+        return MLDP_ERROR_CONFIG;
+    }
+    uint32_t size = 1;
+    while (size < (uint32_t)capacity) {
+        size <<= 1;
+    }
+    queue->buffer = (int16_t*)malloc(size * dimensions * sizeof(int16_t));
+    if (queue->buffer == NULL) {
+        return MLDP_ERROR_ALLOC;
+    }
+    queue->dimensions = dimensions;
+    queue->capacity = size;
+
+    return MLDP_SUCCESS;
+}
+
+void mldpQueue_deinit(MldpQueue_t *queue) {
+    free(queue->buffer);
+    memset(queue, 0, sizeof(MldpQueue_t));
+}
+
+bool mldpQueue_push(MldpQueue_t *queue, const int16_t *sample) {
+    const uint32_t head = queue->head;
+    if (head - LOAD_ACQUIRE(&queue->tail) >= queue->capacity) {
+        STORE_RELEASE(&queue->overruns, queue->overruns + 1);
+        return false;
+    }
+    memcpy(&queue->buffer[(head & (queue->capacity - 1)) * queue->dimensions],
+           sample, queue->dimensions * sizeof(int16_t));
+    STORE_RELEASE(&queue->head, head + 1);
+    return true;
+}
+
+bool mldpQueue_pop(MldpQueue_t *queue, int16_t *sample) {
+    const uint32_t tail = queue->tail;
+    if (LOAD_ACQUIRE(&queue->head) == tail) {
+        return false;
+    }
+    memcpy(sample, &queue->buffer[(tail & (queue->capacity - 1)) * queue->dimensions],
+           queue->dimensions * sizeof(int16_t));
+    STORE_RELEASE(&queue->tail, tail + 1);
+    return true;
+}
+
+int mldpQueue_drain(MldpQueue_t *queue, const MlDataProcessor_t *processor, MldpHandle_t handle) {
+    const uint32_t head = LOAD_ACQUIRE(&queue->head);
+    uint32_t tail = queue->tail;
+    int recorded = 0;
+    // The samples are recorded straight from the buffer, in up to two
+    // contiguous runs when they wrap around its end
+    while (tail != head) {
+        const uint32_t start = tail & (queue->capacity - 1);
+        uint32_t count = head - tail;
+        if (start + count > queue->capacity) {
+            count = queue->capacity - start;
+        }
+        MldpReturn_t result = processor->recordDataInt16(
+            handle, &queue->buffer[start * queue->dimensions], count * queue->dimensions);
+        // Samples that can't be recorded are dropped anyway, otherwise the
+        // queue would never empty and every new sample would overrun it
+        tail += count;
+        // Release the space as soon as possible for the producer
+        STORE_RELEASE(&queue->tail, tail);
+        if (result != MLDP_SUCCESS) {
+            return result;
+        }
+        recorded += count;
+    }
+    return recorded;
+}
+
+uint32_t mldpQueue_overruns(const MldpQueue_t *queue) {
+    return LOAD_ACQUIRE(&queue->overruns);
+}
@@ -0,0 +1,74 @@
+/**
+ * @brief Lock-free queue to record samples from an interrupt.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ *
+ * @details
+ * The data processors are not safe to use from an interrupt, as recording a
+ * sample updates several fields of the instance. Instead, the interrupt
+ * handler (the single producer) pushes the raw samples to this queue, and
+ * the fiber that runs the model (the single consumer) drains them into the
+ * data processor.
+ *
+ * The producer and consumer only write their own index, so no locks are
+ * needed. When the queue is full the new sample is dropped and counted as
+ * an overrun, so that the consumer can tell that samples are missing.
+ */
+#pragma once
+
+#include "mldataprocessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int16_t *buffer;
+    int dimensions;
+    uint32_t capacity;          // In samples, a power of two
+    uint32_t head;              // Samples pushed, only written by the producer
+    uint32_t tail;              // Samples popped, only written by the consumer
+    uint32_t overruns;          // Samples dropped, only written by the producer
+} MldpQueue_t;
+
+/**
+ * @param capacity Number of samples, rounded up to a power of two.
+ */
+MldpReturn_t mldpQueue_init(MldpQueue_t *queue, const int dimensions, const int capacity);
+
+void mldpQueue_deinit(MldpQueue_t *queue);
+
+/**
+ * @brief Add a sample with all its dimensions, safe to call from an interrupt.
+ *
+ * @return False if the queue is full and the sample has been dropped.
+ */
+bool mldpQueue_push(MldpQueue_t *queue, const int16_t *sample);
+
+/**
+ * @brief Take the oldest sample from the queue.
+ *
+ * @return False if the queue is empty.
+ */
+bool mldpQueue_pop(MldpQueue_t *queue, int16_t *sample);
+
+/**
+ * @brief Record all the samples in the queue with a data processor.
+ *
+ * @return The number of samples recorded, or a negative MldpReturn_t if the
+ *         data processor failed to record them. The samples it failed to
+ *         record are removed from the queue, the rest are kept.
+ */
+int mldpQueue_drain(MldpQueue_t *queue, const MlDataProcessor_t *processor, MldpHandle_t handle);
+
+/**
+ * @return The number of samples dropped because the queue was full, since
+ *         the queue was initialised.
+ */
+uint32_t mldpQueue_overruns(const MldpQueue_t *queue);
+
+#ifdef __cplusplus
+}
+#endif
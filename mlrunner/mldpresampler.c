@@ -0,0 +1,248 @@
+/**
+ * @brief Converts the samples from the sensor period to the period expected
+ * by the model.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ */
+#include <math.h>
+#include <string.h>
+#include "mldpresampler.h"
+
+#define MLDP_PI 3.14159265358979f
+
+
+/**
+ * @brief Windowed sinc low-pass filter, with the cut-off at the Nyquist
+ * frequency of the output and a gain of 1.
+ */
+static void design_filter(float *coefficients, const int taps, const int factor) {
+    const float cutoff = 0.5f / factor;
+    const float middle = (taps - 1) / 2.0f;
+    float sum = 0;
+    for (int i = 0; i < taps; i++) {
+        const float t = i - middle;
+        const float sinc = t == 0 ? 2 * cutoff : sinf(2 * MLDP_PI * cutoff * t) / (MLDP_PI * t);
+        // Hamming window
+        const float window = 0.54f - 0.46f * cosf(2 * MLDP_PI * i / (taps - 1));
+        coefficients[i] = sinc * window;
+        sum += coefficients[i];
+    }
+    for (int i = 0; i < taps; i++) {
+        coefficients[i] /= sum;
+    }
+}
+
+MldpReturn_t mldpResampler_init(MldpResampler_t *rs, const int dimensions, const int input_period, const int output_period) {
+    memset(rs, 0, sizeof(MldpResampler_t));
+    if (dimensions <= 0 || input_period <= 0 || output_period <= 0) {
+        return MLDP_ERROR_CONFIG;
+    }
+    rs->dimensions = dimensions;
+    rs->input_period = input_period;
+    rs->output_period = output_period;
+
+    if (input_period == output_period) {
+        rs->mode = MLDP_RESAMPLE_NONE;
+    } else if (output_period % input_period == 0) {
+        rs->mode = MLDP_RESAMPLE_DECIMATE;
+        rs->factor = output_period / input_period;
+        rs->taps = MLDP_RESAMPLER_TAPS_PER_PHASE * rs->factor;
+        rs->coefficients = (float*)malloc(rs->taps * sizeof(float));
+        rs->accumulators = (float*)calloc(MLDP_RESAMPLER_TAPS_PER_PHASE * dimensions, sizeof(float));
+        if (rs->coefficients == NULL || rs->accumulators == NULL) {
+            mldpResampler_deinit(rs);
+            return MLDP_ERROR_ALLOC;
+        }
+        design_filter(rs->coefficients, rs->taps, rs->factor);
+    } else {
+        rs->mode = MLDP_RESAMPLE_LINEAR;
+        rs->previous = (float*)malloc(dimensions * sizeof(float));
+        if (rs->previous == NULL) {
+            mldpResampler_deinit(rs);
+            return MLDP_ERROR_ALLOC;
+        }
+    }
+
+    return MLDP_SUCCESS;
+}
+
+void mldpResampler_deinit(MldpResampler_t *rs) {
+    free(rs->coefficients);
+    free(rs->accumulators);
+    free(rs->previous);
+    memset(rs, 0, sizeof(MldpResampler_t));
+}
+
+int mldpResampler_maxOutputs(const MldpResampler_t *rs) {
+    if (rs->mode == MLDP_RESAMPLE_LINEAR) {
+        return (rs->input_period + rs->output_period - 1) / rs->output_period;
+    }
+    return 1;
+}
+
+/**
+ * @brief Adds the inputs before the first one, all equal to it, to the
+ * outputs they contribute to: the taps past m * factor of the output m.
+ */
+static void prime_decimator(MldpResampler_t *rs, const float *sample) {
+    for (int m = 0; m < MLDP_RESAMPLER_TAPS_PER_PHASE; m++) {
+        float gain = 0;
+        for (int tap = m * rs->factor + 1; tap < rs->taps; tap++) {
+            gain += rs->coefficients[tap];
+        }
+        float *acc = &rs->accumulators[m * rs->dimensions];
+        for (int d_i = 0; d_i < rs->dimensions; d_i++) {
+            acc[d_i] = gain * sample[d_i];
+        }
+    }
+    rs->primed = true;
+}
+
+/**
+ * @brief Output m is complete with the input m * factor, and the input n is
+ * added to the outputs with 0 <= m * factor - n < taps, which are always
+ * within the next MLDP_RESAMPLER_TAPS_PER_PHASE outputs.
+ */
+static int decimate(MldpResampler_t *rs, const float *sample, float *data_out) {
+    if (!rs->primed) {
+        prime_decimator(rs, sample);
+    }
+    const unsigned int n = rs->input_index++;
+    const int factor = rs->factor;
+    const unsigned int first_output = (n + factor - 1) / factor;
+    int outputs = 0;
+    for (int p_i = 0; p_i < MLDP_RESAMPLER_TAPS_PER_PHASE; p_i++) {
+        const unsigned int m = first_output + p_i;
+        const unsigned int tap = m * factor - n;
+        if (tap >= (unsigned int)rs->taps) break;
+        float *acc = &rs->accumulators[(m % MLDP_RESAMPLER_TAPS_PER_PHASE) * rs->dimensions];
+        for (int d_i = 0; d_i < rs->dimensions; d_i++) {
+            acc[d_i] += rs->coefficients[tap] * sample[d_i];
+        }
+        if (tap == 0) {
+            // Last input for this output, its accumulator is reused after
+            // MLDP_RESAMPLER_TAPS_PER_PHASE outputs
+            memcpy(data_out, acc, rs->dimensions * sizeof(float));
+            memset(acc, 0, rs->dimensions * sizeof(float));
+            outputs = 1;
+        }
+    }
+    return outputs;
+}
+
+static int interpolate(MldpResampler_t *rs, const float *sample, float *data_out) {
+    if (!rs->has_previous) {
+        // The first output is the first input
+        memcpy(rs->previous, sample, rs->dimensions * sizeof(float));
+        memcpy(data_out, sample, rs->dimensions * sizeof(float));
+        rs->has_previous = true;
+        rs->next_time = rs->output_period;
+        return 1;
+    }
+    int outputs = 0;
+    while (rs->next_time <= rs->input_period) {
+        const float fraction = (float)rs->next_time / rs->input_period;
+        for (int d_i = 0; d_i < rs->dimensions; d_i++) {
+            data_out[d_i] = rs->previous[d_i] + fraction * (sample[d_i] - rs->previous[d_i]);
+        }
+        data_out += rs->dimensions;
+        rs->next_time += rs->output_period;
+        outputs++;
+    }
+    rs->next_time -= rs->input_period;
+    memcpy(rs->previous, sample, rs->dimensions * sizeof(float));
+    return outputs;
+}
+
+int mldpResampler_push(MldpResampler_t *rs, const float *sample, float *data_out) {
+    if (rs->mode == MLDP_RESAMPLE_DECIMATE) {
+        return decimate(rs, sample, data_out);
+    }
+    if (rs->mode == MLDP_RESAMPLE_LINEAR) {
+        return interpolate(rs, sample, data_out);
+    }
+    memcpy(data_out, sample, rs->dimensions * sizeof(float));
+    return 1;
+}
+
+MldpReturn_t mldpRegrid_init(MldpRegrid_t *rg, const int dimensions, const int period) {
+    memset(rg, 0, sizeof(MldpRegrid_t));
+    if (dimensions <= 0 || period <= 0) {
+        return MLDP_ERROR_CONFIG;
+    }
+    rg->dimensions = dimensions;
+    rg->period = period;
+    rg->previous = (float*)malloc(dimensions * sizeof(float));
+    rg->current = (float*)malloc(dimensions * sizeof(float));
+    if (rg->previous == NULL || rg->current == NULL) {
+        mldpRegrid_deinit(rg);
+        return MLDP_ERROR_ALLOC;
+    }
+    mldpRegrid_resetJitter(rg);
+
+    return MLDP_SUCCESS;
+}
+
+void mldpRegrid_deinit(MldpRegrid_t *rg) {
+    free(rg->previous);
+    free(rg->current);
+    memset(rg, 0, sizeof(MldpRegrid_t));
+}
+
+void mldpRegrid_resetJitter(MldpRegrid_t *rg) {
+    memset(&rg->jitter, 0, sizeof(MldpJitter_t));
+}
+
+static void update_jitter(MldpRegrid_t *rg, const int32_t interval) {
+    MldpJitter_t *jitter = &rg->jitter;
+    const int32_t deviation = interval - rg->period;
+    if (jitter->intervals == 0 || deviation < jitter->min_deviation) jitter->min_deviation = deviation;
+    if (jitter->intervals == 0 || deviation > jitter->max_deviation) jitter->max_deviation = deviation;
+    jitter->intervals++;
+    jitter->mean_deviation += ((deviation < 0 ? -deviation : deviation) - jitter->mean_deviation) / jitter->intervals;
+    // Rounded to the closest number of periods
+    const int32_t periods = (interval + rg->period / 2) / rg->period;
+    if (periods > 1) {
+        jitter->missed += periods - 1;
+    }
+}
+
+bool mldpRegrid_push(MldpRegrid_t *rg, const float *sample, const uint32_t time) {
+    if (!rg->has_previous) {
+        // The grid starts with the first sample
+        memcpy(rg->current, sample, rg->dimensions * sizeof(float));
+        memcpy(rg->previous, sample, rg->dimensions * sizeof(float));
+        rg->previous_time = time;
+        rg->current_time = time;
+        rg->next_time = time;
+        rg->has_previous = true;
+        return true;
+    }
+    const int32_t interval = (int32_t)(time - rg->current_time);
+    if (interval <= 0) {
+        return false;
+    }
+    update_jitter(rg, interval);
+    float *previous = rg->previous;
+    rg->previous = rg->current;
+    rg->current = previous;
+    memcpy(rg->current, sample, rg->dimensions * sizeof(float));
+    rg->previous_time = rg->current_time;
+    rg->current_time = time;
+    return true;
+}
+
+bool mldpRegrid_next(MldpRegrid_t *rg, float *data_out) {
+    if (!rg->has_previous || (int32_t)(rg->current_time - rg->next_time) < 0) {
+        return false;
+    }
+    const int32_t interval = (int32_t)(rg->current_time - rg->previous_time);
+    const float fraction = interval == 0 ? 1.0f : (float)(int32_t)(rg->next_time - rg->previous_time) / interval;
+    for (int d_i = 0; d_i < rg->dimensions; d_i++) {
+        data_out[d_i] = rg->previous[d_i] + fraction * (rg->current[d_i] - rg->previous[d_i]);
+    }
+    rg->next_time += rg->period;
+    return true;
+}
@@ -0,0 +1,120 @@
+/**
+ * @brief Converts the samples from the sensor period to the period expected
+ * by the model.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ *
+ * @details
+ * When the output period is a multiple of the input period the samples are
+ * decimated with a low-pass FIR filter in polyphase form: each input sample
+ * is added to the few outputs it contributes to, so the cost per sample is
+ * bounded by MLDP_RESAMPLER_TAPS_PER_PHASE multiply-adds per dimension.
+ * The filter history before the first input is primed with that input, as
+ * if the sensor had been holding it, so the first outputs don't ramp up from
+ * zero and are valid as soon as they are produced.
+ *
+ * For any other ratio the output is linearly interpolated between the two
+ * closest input samples. The sample times are tracked as integers, so the
+ * output doesn't drift over time.
+ *
+ * Samples with irregular timestamps can be placed on a regular grid first,
+ * with MldpRegrid_t, which also measures how much they deviate from it.
+ */
+#pragma once
+
+#include "mldataprocessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Length of the decimation filter in input samples per output sample
+#define MLDP_RESAMPLER_TAPS_PER_PHASE 4
+
+typedef enum {
+    MLDP_RESAMPLE_NONE = 0,
+    MLDP_RESAMPLE_DECIMATE = 1,
+    MLDP_RESAMPLE_LINEAR = 2,
+} MldpResampleMode_t;
+
+typedef struct {
+    MldpResampleMode_t mode;
+    int dimensions;
+    int input_period;
+    int output_period;
+    // Decimation
+    int factor;                 // Input samples per output sample
+    int taps;
+    float *coefficients;
+    float *accumulators;        // MLDP_RESAMPLER_TAPS_PER_PHASE pending outputs
+    unsigned int input_index;
+    bool primed;                // The history has been filled with the first input
+    // Linear interpolation
+    float *previous;
+    bool has_previous;
+    int next_time;              // Time of the next output from the previous input
+} MldpResampler_t;
+
+/**
+ * @param input_period Period of the input samples, in any time unit.
+ * @param output_period Period of the output samples, in the same unit.
+ */
+MldpReturn_t mldpResampler_init(MldpResampler_t *rs, const int dimensions, const int input_period, const int output_period);
+
+void mldpResampler_deinit(MldpResampler_t *rs);
+
+/**
+ * @return The maximum number of output samples for each input sample.
+ */
+int mldpResampler_maxOutputs(const MldpResampler_t *rs);
+
+/**
+ * @brief Add an input sample.
+ *
+ * @param data_out Buffer for mldpResampler_maxOutputs() samples of all
+ *                 the dimensions.
+ * @return The number of output samples written to data_out.
+ */
+int mldpResampler_push(MldpResampler_t *rs, const float *sample, float *data_out);
+
+typedef struct {
+    int dimensions;
+    int period;
+    float *previous;
+    float *current;
+    uint32_t previous_time;
+    uint32_t current_time;
+    uint32_t next_time;         // Time of the next grid point
+    bool has_previous;
+    MldpJitter_t jitter;
+} MldpRegrid_t;
+
+/**
+ * @param period Period of the grid, in the same unit as the timestamps.
+ */
+MldpReturn_t mldpRegrid_init(MldpRegrid_t *rg, const int dimensions, const int period);
+
+void mldpRegrid_deinit(MldpRegrid_t *rg);
+
+/**
+ * @brief Add a sample and update the jitter statistics. The timestamps can
+ * wrap around, but must be less than 2^31 apart.
+ *
+ * @return False if the sample is not newer than the previous one, in which
+ *         case it's ignored.
+ */
+bool mldpRegrid_push(MldpRegrid_t *rg, const float *sample, const uint32_t time);
+
+/**
+ * @brief Get the next grid point up to the newest sample, call until it
+ * returns false after each mldpRegrid_push().
+ */
+bool mldpRegrid_next(MldpRegrid_t *rg, float *data_out);
+
+void mldpRegrid_resetJitter(MldpRegrid_t *rg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,192 @@
+/**
+ * @brief Samples ring shared by several data processors.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ */
+#include <string.h>
+#include "mldpring.h"
+#include "mldpkernels.h"
+
+
+MldpReturn_t mldpRing_init(MldpRing_t *ring, const int dimensions, const int length,
+                           const MldpStorage_t storage, const float *scale) {
+    memset(ring, 0, sizeof(MldpRing_t));
+    if (dimensions <= 0 || length <= 0 ||
+            (storage != MLDP_STORAGE_FLOAT && storage != MLDP_STORAGE_INT16)) {
+        return MLDP_ERROR_CONFIG;
+    }
+    ring->dimensions = dimensions;
+    ring->length = length;
+
+    ring->scales = (float*)malloc(2 * dimensions * sizeof(float));
+    ring->inverse_scales = ring->scales != NULL ? &ring->scales[dimensions] : NULL;
+    if (storage == MLDP_STORAGE_INT16) {
+        ring->samples_i16 = (int16_t**)calloc(dimensions, sizeof(int16_t*));
+    } else {
+        ring->samples = (float**)calloc(dimensions, sizeof(float*));
+    }
+    if (ring->scales == NULL || (ring->samples == NULL && ring->samples_i16 == NULL)) {
+        mldpRing_deinit(ring);
+        return MLDP_ERROR_ALLOC;
+    }
+    for (int i = 0; i < dimensions; i++) {
+        ring->scales[i] = scale != NULL ? scale[i] : 1.0f;
+        if (ring->scales[i] == 0.0f) {
+            mldpRing_deinit(ring);
+            return MLDP_ERROR_CONFIG;
+        }
+        ring->inverse_scales[i] = 1.0f / ring->scales[i];
+        if (ring->samples_i16 != NULL) {
+            ring->samples_i16[i] = (int16_t*)calloc(length, sizeof(int16_t));
+        } else {
+            ring->samples[i] = (float*)calloc(length, sizeof(float));
+        }
+        if ((ring->samples_i16 != NULL && ring->samples_i16[i] == NULL) ||
+                (ring->samples != NULL && ring->samples[i] == NULL)) {
+            mldpRing_deinit(ring);
+            return MLDP_ERROR_ALLOC;
+        }
+    }
+
+    return MLDP_SUCCESS;
+}
+
+void mldpRing_deinit(MldpRing_t *ring) {
+    for (int i = 0; i < ring->dimensions; i++) {
+        if (ring->samples != NULL) free(ring->samples[i]);
+        if (ring->samples_i16 != NULL) free(ring->samples_i16[i]);
+    }
+    free(ring->samples);
+    free(ring->samples_i16);
+    free(ring->scales);
+    memset(ring, 0, sizeof(MldpRing_t));
+}
+
+MldpReturn_t mldpRing_attach(MldpRing_t *ring, MldpRingView_t *view,
+                             const int length, const int min_samples, const int hop) {
+    if (length <= 0 || length > ring->length || min_samples <= 0 || min_samples > length || hop < 0) {
+        return MLDP_ERROR_CONFIG;
+    }
+    view->length = length;
+    view->min_samples = min_samples;
+    view->hop = hop > 0 ? hop : 1;
+    view->hop_index = 0;
+    // The samples already recorded count as a first window if there are enough
+    view->started = ring->recorded >= min_samples;
+    view->windows_ready = view->started ? 1 : 0;
+    view->next = ring->views;
+    ring->views = view;
+
+    return MLDP_SUCCESS;
+}
+
+void mldpRing_detach(MldpRing_t *ring, MldpRingView_t *view) {
+    for (MldpRingView_t **v = &ring->views; *v != NULL; v = &(*v)->next) {
+        if (*v == view) {
+            *v = view->next;
+            view->next = NULL;
+            return;
+        }
+    }
+}
+
+// Move to the next sample, after all dimensions have been stored
+static void next_sample(MldpRing_t *ring) {
+    ring->index++;
+    if (ring->index >= ring->length) {
+        ring->index = 0;
+    }
+    if (ring->recorded < ring->length) {
+        ring->recorded++;
+    }
+    // The first window of each view is ready with min_samples, and then every hop
+    for (MldpRingView_t *view = ring->views; view != NULL; view = view->next) {
+        if (!view->started) {
+            if (ring->recorded >= view->min_samples) {
+                view->started = true;
+                view->hop_index = 0;
+                view->windows_ready++;
+            }
+        } else if (++view->hop_index >= view->hop) {
+            view->hop_index = 0;
+            view->windows_ready++;
+        }
+    }
+}
+
+MldpReturn_t mldpRing_recordData(MldpRing_t *ring, const float *samples, const int elements) {
+    if (ring->dimensions == 0) return MLDP_ERROR_NOINIT;
+    if (elements % ring->dimensions != 0) return MLDP_ERROR_CONFIG;
+
+    const int number_of_samples = elements / ring->dimensions;
+    for (int s_i = 0; s_i < number_of_samples; s_i++) {
+        for (int d_i = 0; d_i < ring->dimensions; d_i++) {
+            const float value = samples[s_i * ring->dimensions + d_i];
+            if (ring->samples_i16 != NULL) {
+                ring->samples_i16[d_i][ring->index] = mldpKernel_quantise(value, ring->inverse_scales[d_i]);
+            } else {
+                ring->samples[d_i][ring->index] = value;
+            }
+        }
+        next_sample(ring);
+    }
+
+    return MLDP_SUCCESS;
+}
+
+MldpReturn_t mldpRing_recordDataInt16(MldpRing_t *ring, const int16_t *samples, const int elements) {
+    if (ring->dimensions == 0) return MLDP_ERROR_NOINIT;
+    if (elements % ring->dimensions != 0) return MLDP_ERROR_CONFIG;
+
+    const int number_of_samples = elements / ring->dimensions;
+    for (int s_i = 0; s_i < number_of_samples; s_i++) {
+        for (int d_i = 0; d_i < ring->dimensions; d_i++) {
+            const int16_t raw = samples[s_i * ring->dimensions + d_i];
+            if (ring->samples_i16 != NULL) {
+                ring->samples_i16[d_i][ring->index] = raw;
+            } else {
+                ring->samples[d_i][ring->index] = raw * ring->scales[d_i];
+            }
+        }
+        next_sample(ring);
+    }
+
+    return MLDP_SUCCESS;
+}
+
+bool mldpRing_isReady(MldpRingView_t *view, int *missed_hops) {
+    if (missed_hops != NULL) *missed_hops = 0;
+    if (view->windows_ready == 0) return false;
+
+    if (missed_hops != NULL) *missed_hops = view->windows_ready - 1;
+    view->windows_ready = 0;
+    return true;
+}
+
+float mldpRing_sampleAt(const MldpRing_t *ring, const int dimension, const int age) {
+    int s_i = ring->index - 1 - age;
+    if (s_i < 0) s_i += ring->length;
+    if (ring->samples_i16 != NULL) {
+        return ring->samples_i16[dimension][s_i] * ring->scales[dimension];
+    }
+    return ring->samples[dimension][s_i];
+}
+
+void mldpRing_copyWindow(const MldpRing_t *ring, const int dimension, const int length, float *buffer) {
+    int start = ring->index - length;
+    if (start < 0) start += ring->length;
+    if (ring->samples_i16 != NULL) {
+        const int16_t *samples = ring->samples_i16[dimension];
+        const float scale = ring->scales[dimension];
+        for (int i = 0, s_i = start; i < length; i++, s_i++) {
+            if (s_i >= ring->length) s_i = 0;
+            buffer[i] = samples[s_i] * scale;
+        }
+        return;
+    }
+    const int first = ring->length - start < length ? ring->length - start : length;
+    memcpy(buffer, &ring->samples[dimension][start], first * sizeof(float));
+    memcpy(&buffer[first], ring->samples[dimension], (length - first) * sizeof(float));
+}
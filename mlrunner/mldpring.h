@@ -0,0 +1,99 @@
+/**
+ * @brief Samples ring shared by several data processors.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ *
+ * @details
+ * Each dimension of the recorded samples is stored once, in a ring with the
+ * length of the longest window of its consumers. Each consumer attaches a
+ * view with its own window length, hop and readiness state, and reads its
+ * window as the newest samples of the ring.
+ *
+ * A filter data processor uses a ring when it's set in
+ * MlDataProcessorConfig_t.ring, and then the samples are recorded with
+ * mldpRing_recordData() instead of the processor recordData().
+ */
+#pragma once
+
+#include "mldataprocessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MldpRingView_s {
+    int length;                 // Window length, up to the ring length
+    int min_samples;            // Samples needed for the first window
+    int hop;
+    int hop_index;              // Samples since the last window
+    bool started;               // The first window has been ready
+    int windows_ready;          // New windows not reported by mldpRing_isReady() yet
+    struct MldpRingView_s *next;
+} MldpRingView_t;
+
+struct MldpRing_s {
+    float **samples;
+    int16_t **samples_i16;      // Used instead of samples for MLDP_STORAGE_INT16
+    float *scales;
+    float *inverse_scales;      // 1 / scales, in the same allocation
+    int dimensions;
+    int length;
+    int index;                  // Position of the next sample, and of the oldest one once filled
+    int recorded;               // Number of samples in the ring, up to its length
+    MldpRingView_t *views;
+};
+
+/**
+ * @param scale Per dimension factor to convert int16 values to float, NULL for 1.0.
+ */
+MldpReturn_t mldpRing_init(MldpRing_t *ring, const int dimensions, const int length,
+                           const MldpStorage_t storage, const float *scale);
+
+// The views have to be detached before the ring is released
+void mldpRing_deinit(MldpRing_t *ring);
+
+/**
+ * @brief Add a view of the newest samples, with its own readiness state.
+ *
+ * @param length Window length, up to the ring length.
+ * @param min_samples Samples needed for the first window, same as length
+ *                    unless the first windows can be partial.
+ * @param hop Samples between consecutive windows, 0 for every new sample.
+ */
+MldpReturn_t mldpRing_attach(MldpRing_t *ring, MldpRingView_t *view,
+                             const int length, const int min_samples, const int hop);
+
+void mldpRing_detach(MldpRing_t *ring, MldpRingView_t *view);
+
+// Record the samples, with the dimensions interleaved, and update the views
+MldpReturn_t mldpRing_recordData(MldpRing_t *ring, const float *samples, const int elements);
+MldpReturn_t mldpRing_recordDataInt16(MldpRing_t *ring, const int16_t *samples, const int elements);
+
+/**
+ * @brief Same as MlDataProcessor_t.isDataReady() for a view.
+ */
+bool mldpRing_isReady(MldpRingView_t *view, int *missed_hops);
+
+/**
+ * @return The number of samples in the window of a view, which is only
+ *         less than the view length before the ring has enough samples.
+ */
+static inline int mldpRing_windowLength(const MldpRing_t *ring, const MldpRingView_t *view) {
+    return ring->recorded < view->length ? ring->recorded : view->length;
+}
+
+/**
+ * @return A sample value of a dimension, age 0 is the newest sample.
+ */
+float mldpRing_sampleAt(const MldpRing_t *ring, const int dimension, const int age);
+
+/**
+ * @brief Copy the newest length samples of a dimension in chronological order.
+ */
+void mldpRing_copyWindow(const MldpRing_t *ring, const int dimension, const int length, float *buffer);
+
+#ifdef __cplusplus
+}
+#endif
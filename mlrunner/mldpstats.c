@@ -0,0 +1,147 @@
+/**
+ * @brief Statistics of a window of samples shared between the data filters.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ */
+#include <math.h>
+#include "mldpstats.h"
+
+
+// The stats version of each built-in filter and the statistics it needs
+static const struct {
+    MldpFilterFn_t filter;
+    MldpStatsFilterFn_t stats_filter;
+    uint32_t stats;
+} builtin_stats_filters[] = {
+    { filterMax, statsFilterMax, MLDP_STAT_MAX },
+    { filterMin, statsFilterMin, MLDP_STAT_MIN },
+    { filterMean, statsFilterMean, MLDP_STAT_SUM },
+    { filterStdDev, statsFilterStdDev, MLDP_STAT_M2 },
+    { filterTotalAcc, statsFilterTotalAcc, MLDP_STAT_SUM_ABS },
+    { filterZcr, statsFilterZcr, MLDP_STAT_ZERO_CROSSINGS },
+    { filterRms, statsFilterRms, MLDP_STAT_SUM_SQ },
+};
+
+void mldpStats_reset(MldpStats_t *stats, const int in_size) {
+    stats->size = in_size;
+    stats->available = 0;
+}
+
+void mldpStats_compute(MldpStats_t *stats, const float *data_in, const uint32_t required) {
+    const uint32_t missing = required & ~stats->available;
+    if (missing == 0 || stats->size < 1) {
+        return;
+    }
+
+    float sum = 0;
+    float sum_abs = 0;
+    float sum_sq = 0;
+    float min = data_in[0];
+    float max = data_in[0];
+    float mean = 0;
+    float m2 = 0;
+    int zero_crossings = 0;
+    for (int i = 0; i < stats->size; i++) {
+        const float value = data_in[i];
+        if (missing & MLDP_STAT_SUM) sum += value;
+        if (missing & MLDP_STAT_SUM_ABS) sum_abs += fabsf(value);
+        if (missing & MLDP_STAT_SUM_SQ) sum_sq += value * value;
+        if (missing & MLDP_STAT_MIN) { if (value < min) min = value; }
+        if (missing & MLDP_STAT_MAX) { if (value > max) max = value; }
+        if (missing & MLDP_STAT_M2) {
+            // Welford's online algorithm, to avoid a second pass for the mean
+            const float delta = value - mean;
+            mean += delta / (i + 1);
+            m2 += delta * (value - mean);
+        }
+        if ((missing & MLDP_STAT_ZERO_CROSSINGS) && i > 0 && (
+            (value >= 0 && data_in[i - 1] < 0) ||
+            (value < 0 && data_in[i - 1] >= 0))
+        ) {
+            zero_crossings++;
+        }
+    }
+
+    if (missing & MLDP_STAT_SUM) stats->sum = sum;
+    if (missing & MLDP_STAT_SUM_ABS) stats->sum_abs = sum_abs;
+    if (missing & MLDP_STAT_SUM_SQ) stats->sum_sq = sum_sq;
+    if (missing & MLDP_STAT_MIN) stats->min = min;
+    if (missing & MLDP_STAT_MAX) stats->max = max;
+    if (missing & MLDP_STAT_M2) stats->m2 = m2;
+    if (missing & MLDP_STAT_ZERO_CROSSINGS) stats->zero_crossings = zero_crossings;
+    stats->available |= missing;
+}
+
+MldpStatsFilterFn_t mldpStats_findFilter(MldpFilterFn_t filter, uint32_t *stats) {
+    for (size_t i = 0; i < sizeof(builtin_stats_filters) / sizeof(builtin_stats_filters[0]); i++) {
+        if (builtin_stats_filters[i].filter == filter) {
+            *stats = builtin_stats_filters[i].stats;
+            return builtin_stats_filters[i].stats_filter;
+        }
+    }
+    *stats = 0;
+    return NULL;
+}
+
+MldpReturn_t statsFilterMax(const MldpStats_t *stats, float *data_out, const int out_size) {
+    if (stats->size < 1 || out_size != 1 || !(stats->available & MLDP_STAT_MAX)) {
+        return MLDP_ERROR_CONFIG;
+    }
+    *data_out = stats->max;
+    return MLDP_SUCCESS;
+}
+
+MldpReturn_t statsFilterMin(const MldpStats_t *stats, float *data_out, const int out_size) {
+    if (stats->size < 1 || out_size != 1 || !(stats->available & MLDP_STAT_MIN)) {
+        return MLDP_ERROR_CONFIG;
+    }
+    *data_out = stats->min;
+    return MLDP_SUCCESS;
+}
+
+MldpReturn_t statsFilterMean(const MldpStats_t *stats, float *data_out, const int out_size) {
+    if (stats->size < 1 || out_size != 1 || !(stats->available & MLDP_STAT_SUM)) {
+        return MLDP_ERROR_CONFIG;
+    }
+    *data_out = stats->sum / stats->size;
+    return MLDP_SUCCESS;
+}
+
+// Standard Deviation
+MldpReturn_t statsFilterStdDev(const MldpStats_t *stats, float *data_out, const int out_size) {
+    if (stats->size < 1 || out_size != 1 || !(stats->available & MLDP_STAT_M2)) {
+        return MLDP_ERROR_CONFIG;
+    }
+    *data_out = sqrtf(stats->m2 / stats->size);
+    return MLDP_SUCCESS;
+}
+
+// Total Absolute Acceleration
+MldpReturn_t statsFilterTotalAcc(const MldpStats_t *stats, float *data_out, const int out_size) {
+    if (stats->size < 1 || out_size != 1 || !(stats->available & MLDP_STAT_SUM_ABS)) {
+        return MLDP_ERROR_CONFIG;
+    }
+    *data_out = stats->sum_abs;
+    return MLDP_SUCCESS;
+}
+
+// Zero Crossing Rate
+MldpReturn_t statsFilterZcr(const MldpStats_t *stats, float *data_out, const int out_size) {
+    if (stats->size < 2 || out_size != 1 || !(stats->available & MLDP_STAT_ZERO_CROSSINGS)) {
+        return MLDP_ERROR_CONFIG;
+    }
+    // Integer division to match filterZcr()
+    *data_out = stats->zero_crossings / (stats->size - 1);
+    return MLDP_SUCCESS;
+}
+
+// Root Mean Square
+MldpReturn_t statsFilterRms(const MldpStats_t *stats, float *data_out, const int out_size) {
+    if (stats->size < 1 || out_size != 1 || !(stats->available & MLDP_STAT_SUM_SQ)) {
+        return MLDP_ERROR_CONFIG;
+    }
+    *data_out = sqrtf(stats->sum_sq / stats->size);
+    return MLDP_SUCCESS;
+}
@@ -0,0 +1,79 @@
+/**
+ * @brief Statistics of a window of samples shared between the data filters.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ *
+ * @details
+ * Several filters need the same intermediate values, like the sum of the
+ * samples for the mean and for the standard deviation, or the sum of squares
+ * for the root mean square. The filter data processor calculates all the
+ * statistics needed by the configured filters in a single pass through each
+ * window, and the stats filters produce their output from them.
+ *
+ * A filter declares the statistics it needs with the MLDP_STAT_* flags in
+ * MlDataFilters_t.stats, together with its MlDataFilters_t.stats_filter.
+ * The built-in filters are mapped to their stats version automatically.
+ */
+#pragma once
+
+#include "mldataprocessor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Flags for the statistics needed by a stats filter
+#define MLDP_STAT_SUM               (1u << 0)
+#define MLDP_STAT_SUM_ABS           (1u << 1)
+#define MLDP_STAT_SUM_SQ            (1u << 2)
+#define MLDP_STAT_MIN               (1u << 3)
+#define MLDP_STAT_MAX               (1u << 4)
+#define MLDP_STAT_M2                (1u << 5)
+#define MLDP_STAT_ZERO_CROSSINGS    (1u << 6)
+
+struct MldpStats_s {
+    int size;                   // Number of samples in the window
+    uint32_t available;         // MLDP_STAT_* flags of the values already calculated
+    float sum;
+    float sum_abs;
+    float sum_sq;
+    float min;
+    float max;
+    float m2;                   // Sum of squared differences from the mean
+    int zero_crossings;
+};
+
+/**
+ * @brief Discard the statistics from the previous window.
+ */
+void mldpStats_reset(MldpStats_t *stats, const int in_size);
+
+/**
+ * @brief Calculate the required statistics that are not available yet, in a
+ * single pass through the window.
+ *
+ * @param required MLDP_STAT_* flags.
+ */
+void mldpStats_compute(MldpStats_t *stats, const float *data_in, const uint32_t required);
+
+/**
+ * @brief Find the stats version of a built-in filter.
+ *
+ * @param stats Set to the MLDP_STAT_* flags needed by the stats filter.
+ * @return NULL if the filter doesn't have a stats version.
+ */
+MldpStatsFilterFn_t mldpStats_findFilter(MldpFilterFn_t filter, uint32_t *stats);
+
+MldpReturn_t statsFilterMax(const MldpStats_t *stats, float *data_out, const int out_size);
+MldpReturn_t statsFilterMin(const MldpStats_t *stats, float *data_out, const int out_size);
+MldpReturn_t statsFilterMean(const MldpStats_t *stats, float *data_out, const int out_size);
+MldpReturn_t statsFilterStdDev(const MldpStats_t *stats, float *data_out, const int out_size);
+MldpReturn_t statsFilterTotalAcc(const MldpStats_t *stats, float *data_out, const int out_size);
+MldpReturn_t statsFilterZcr(const MldpStats_t *stats, float *data_out, const int out_size);
+MldpReturn_t statsFilterRms(const MldpStats_t *stats, float *data_out, const int out_size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,14 +1,9 @@
 
 #include <stdlib.h>
+#include <string.h>
 #include "ml4f.h"
 #include "mlrunner.h"
 
-// Pointer to the model in flash
-static uint32_t *MODEL_ADDRESS = NULL;
-static uint8_t *model_arena = NULL;
-static size_t input_length = 0;
-static size_t output_length = 0;
-
 /*****************************************************************************/
 /* Private API                                                               */
 /*****************************************************************************/
@@ -42,230 +37,386 @@ static bool is_model_valid(const void *model_address) {
  *
  * @return The ML4F model or NULL if the model is not present or invalid.
  */
-static inline ml4f_header_t* get_ml4f_model() {
-    if (MODEL_ADDRESS == NULL) {
+static inline ml4f_header_t* get_ml4f_model(const ml_model_ctx_t *ctx) {
+    if (ctx == NULL || ctx->model == NULL) {
         return NULL;
     }
-    ml_model_header_t *model_header = (ml_model_header_t *)MODEL_ADDRESS;
-    return (ml4f_header_t *)((uint32_t)model_header + model_header->header_size);
+    return (ml4f_header_t *)((uint32_t)ctx->model + ctx->model->header_size);
+}
+
+/**
+ * @brief Release the model arena and cached information, so that the
+ * context doesn't have a model.
+ */
+static void clear_model(ml_model_ctx_t *ctx) {
+    // A shared arena is kept at its size, as other models might need it
+    free(ctx->arena);
+    // The actions table is a single allocation starting with the labels
+    free(ctx->actions.labels);
+    ctx->model = NULL;
+    ctx->arena = NULL;
+    ctx->input_length = 0;
+    ctx->output_length = 0;
+    ctx->actions = (ml_actions_table_t){ 0 };
+    ctx->labels.num_labels = 0;
+    ctx->labels.labels = NULL;
+}
+
+/**
+ * @brief Parse the actions from the model header into the actions table,
+ * validating each label once.
+ *
+ * @return True if all the actions are valid and within the header size,
+ *         False otherwise.
+ */
+static bool parse_actions(ml_model_ctx_t *ctx) {
+    const ml_model_header_t* const model_header = ctx->model;
+    const size_t len = model_header->number_of_actions;
+
+    // A single allocation for the three arrays, ordered by alignment
+    uint8_t *table = malloc(len * (sizeof(const char *) + sizeof(float) + sizeof(uint8_t)));
+    if (table == NULL) {
+        return false;
+    }
+    ctx->actions.len = len;
+    ctx->actions.labels = (const char **)table;
+    ctx->actions.thresholds = (float *)(table + len * sizeof(const char *));
+    ctx->actions.label_lengths = table + len * (sizeof(const char *) + sizeof(float));
+
+    const uint32_t header_end = (uint32_t)model_header + model_header->header_size;
+    ml_header_action_t *action = (ml_header_action_t *)&model_header->actions[0];
+    for (size_t i = 0; i < len; i++) {
+        // The action has to fit in the header, with at least the null terminator
+        if ((uint32_t)action + ml_action_size_without_label > header_end ||
+                action->label_length == 0 ||
+                (uint32_t)action + ml_action_size_without_label + action->label_length > header_end) {
+            return false;
+        }
+        // Check the label has a single null terminator at the end
+        if (memchr(action->label, '\0', action->label_length) != &action->label[action->label_length - 1]) {
+            return false;
+        }
+        ctx->actions.labels[i] = &action->label[0];
+        ctx->actions.thresholds[i] = action->threshold;
+        ctx->actions.label_lengths[i] = action->label_length;
+
+        // Locate the next action in flash, which is 4 byte aligned
+        action = (ml_header_action_t *)((uint32_t)action + ml_action_size_without_label + action->label_length);
+        action = (ml_header_action_t *)(((uint32_t)action + 3) & ~3);
+    }
+
+    ctx->labels.num_labels = len;
+    ctx->labels.labels = ctx->actions.labels;
+    return true;
+}
+
+/**
+ * @brief Grow a shared arena to be at least size bytes.
+ *
+ * @return True if the arena fits size, False if it could not be reallocated.
+ */
+static bool fit_shared_arena(ml_arena_t *arena, const size_t size) {
+    if (arena->size >= size) {
+        return true;
+    }
+    // The arena content doesn't have to be kept, it's only used during inference
+    if (arena->owner != NULL) {
+        return false;
+    }
+    uint8_t *buffer = malloc(size);
+    if (buffer == NULL) {
+        return false;
+    }
+    free(arena->buffer);
+    arena->buffer = buffer;
+    arena->size = size;
+    return true;
+}
+
+/**
+ * @brief Take the arena to run inference, so that a nested invocation from
+ * another context (e.g. from an interrupt) is detected instead of
+ * overwriting the arena in use.
+ *
+ * @return The arena buffer, or NULL if it's already in use.
+ */
+static uint8_t* acquire_arena(ml_model_ctx_t *ctx) {
+    if (ctx->shared_arena == NULL) {
+        return ctx->arena;
+    }
+    const ml_model_ctx_t *expected = NULL;
+    if (!__atomic_compare_exchange_n(&ctx->shared_arena->owner, &expected, ctx,
+                                     false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+    return ctx->shared_arena->buffer;
+}
+
+static void release_arena(ml_model_ctx_t *ctx) {
+    if (ctx->shared_arena != NULL) {
+        __atomic_store_n(&ctx->shared_arena->owner, NULL, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @return The arena buffer of the model, which might be shared.
+ */
+static inline uint8_t* get_arena(const ml_model_ctx_t *ctx) {
+    return ctx->shared_arena != NULL ? ctx->shared_arena->buffer : ctx->arena;
+}
+
+/**
+ * @brief Run the model on a batch of inputs, with the arena taken for the
+ * whole batch.
+ *
+ * @param inputs Each input is copied to the model input, unless it's NULL
+ *               or already the model input in the arena.
+ * @param in_stride Number of floats from the start of an input to the next.
+ * @param outputs The output of each run is copied there, unless it's NULL.
+ * @param out_stride Number of floats from the start of an output to the next.
+ * @return True if all the model runs were successful, False otherwise.
+ */
+static bool invoke_batch(ml_model_ctx_t *ctx, const float *inputs, const size_t batch, const size_t in_stride,
+                         float *outputs, const size_t out_stride) {
+    uint8_t *arena = acquire_arena(ctx);
+    if (arena == NULL) {
+        return false;
+    }
+    ml4f_header_t *ml4f_model = get_ml4f_model(ctx);
+    float *model_input = (float *)(arena + ml4f_model->input_offset);
+    const float *model_output = (const float *)(arena + ml4f_model->output_offset);
+    int r = 0;
+    for (size_t i = 0; i < batch && r == 0; i++) {
+        const float *input = inputs != NULL ? &inputs[i * in_stride] : NULL;
+        if (input != NULL && input != model_input) {
+            memcpy(model_input, input, ctx->input_length * sizeof(float));
+        }
+        r = ml4f_invoke(ml4f_model, arena);
+        if (r == 0 && outputs != NULL) {
+            memcpy(&outputs[i * out_stride], model_output, ctx->output_length * sizeof(float));
+        }
+    }
+    release_arena(ctx);
+    return r == 0;
+}
+
+static inline bool invoke_model(ml_model_ctx_t *ctx, const float *input, float *output) {
+    return invoke_batch(ctx, input, 1, 0, output, 0);
 }
 
 /*****************************************************************************/
 /* Public API                                                                */
 /*****************************************************************************/
-bool ml_setModel(const void *model_address) {
+ml_model_ctx_t* ml_allocateContext() {
+    return (ml_model_ctx_t *)calloc(1, sizeof(ml_model_ctx_t));
+}
+
+void ml_freeContext(ml_model_ctx_t *ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+    clear_model(ctx);
+    if (ctx->shared_arena != NULL) {
+        ctx->shared_arena->users--;
+    }
+    free(ctx);
+}
+
+ml_arena_t* ml_allocateSharedArena() {
+    return (ml_arena_t *)calloc(1, sizeof(ml_arena_t));
+}
+
+bool ml_freeSharedArena(ml_arena_t *arena) {
+    if (arena == NULL) {
+        return true;
+    }
+    if (arena->users != 0) {
+        return false;
+    }
+    free(arena->buffer);
+    free(arena);
+    return true;
+}
+
+bool ml_useSharedArena(ml_model_ctx_t *ctx, ml_arena_t *arena) {
+    if (ctx == NULL || ctx->model != NULL) {
+        return false;
+    }
+    if (ctx->shared_arena != NULL) {
+        ctx->shared_arena->users--;
+    }
+    ctx->shared_arena = arena;
+    if (arena != NULL) {
+        arena->users++;
+    }
+    return true;
+}
+
+bool ml_setModel(ml_model_ctx_t *ctx, const void *model_address) {
+    if (ctx == NULL) {
+        return false;
+    }
+    // The previous model information is not valid for the new one
+    clear_model(ctx);
+
     // Check if the model is valid
-    if (!is_model_valid(model_address)) {
+    if (model_address == NULL || !is_model_valid(model_address)) {
+        return false;
+    }
+    ctx->model = (const ml_model_header_t *)model_address;
+
+    // The header is validated once, and then read from the actions table
+    if (!parse_actions(ctx)) {
+        clear_model(ctx);
         return false;
     }
-    MODEL_ADDRESS = (uint32_t *)model_address;
 
     // Allocate the model arena
-    int model_arena_size = ml_getArenaSize();
+    int model_arena_size = ml_getArenaSize(ctx);
     if (model_arena_size <= 0) {
-        MODEL_ADDRESS = NULL;
+        clear_model(ctx);
         return false;
     }
-    if (model_arena != NULL) {
-        free(model_arena);
-    }
-    model_arena = malloc(model_arena_size);
-    if (model_arena == NULL) {
-        MODEL_ADDRESS = NULL;
-        return false;
+    if (ctx->shared_arena != NULL) {
+        if (!fit_shared_arena(ctx->shared_arena, model_arena_size)) {
+            clear_model(ctx);
+            return false;
+        }
+    } else {
+        ctx->arena = malloc(model_arena_size);
+        if (ctx->arena == NULL) {
+            clear_model(ctx);
+            return false;
+        }
     }
 
-    // Set the cached input and output lengths
-    ml_getInputLength();
-    ml_getOutputLength();
+    // Cache the input and output lengths
+    ml4f_header_t *ml4f_model = get_ml4f_model(ctx);
+    ctx->input_length = ml4f_shape_elements(ml4f_input_shape(ml4f_model));
+    ctx->output_length = ml4f_shape_elements(ml4f_output_shape(ml4f_model));
 
     return true;
 }
 
-bool ml_isModelPresent() {
-    return MODEL_ADDRESS != NULL;
+bool ml_isModelPresent(const ml_model_ctx_t *ctx) {
+    return ctx != NULL && ctx->model != NULL;
 }
 
-int ml_getArenaSize() {
-    ml4f_header_t *ml4f_model = get_ml4f_model();
+int ml_getArenaSize(const ml_model_ctx_t *ctx) {
+    ml4f_header_t *ml4f_model = get_ml4f_model(ctx);
     if (ml4f_model == NULL) {
         return -1;
     }
     return ml4f_model->arena_bytes;
 }
 
-int ml_getSamplesPeriod() {
-    const ml_model_header_t* const model_header = (ml_model_header_t*)MODEL_ADDRESS;
+int ml_getSamplesPeriod(const ml_model_ctx_t *ctx) {
+    const ml_model_header_t* const model_header = ctx != NULL ? ctx->model : NULL;
     if (model_header == NULL) {
         return -1;
     }
     return model_header->samples_period;
 }
 
-int ml_getSamplesLength() {
-    const ml_model_header_t* const model_header = (ml_model_header_t*)MODEL_ADDRESS;
+int ml_getSamplesLength(const ml_model_ctx_t *ctx) {
+    const ml_model_header_t* const model_header = ctx != NULL ? ctx->model : NULL;
     if (model_header == NULL) {
         return -1;
     }
     return model_header->samples_length;
 }
 
-int ml_getSampleDimensions() {
-    const ml_model_header_t* const model_header = (ml_model_header_t*)MODEL_ADDRESS;
+int ml_getSampleDimensions(const ml_model_ctx_t *ctx) {
+    const ml_model_header_t* const model_header = ctx != NULL ? ctx->model : NULL;
     if (model_header == NULL) {
         return -1;
     }
     return model_header->sample_dimensions;
 }
 
-int ml_getInputLength() {
-    if (input_length == 0) {
-        ml4f_header_t *ml4f_model = get_ml4f_model();
-        if (ml4f_model == NULL) {
-            return -1;
-        }
-        input_length = ml4f_shape_elements(ml4f_input_shape(ml4f_model));
+int ml_getInputLength(const ml_model_ctx_t *ctx) {
+    if (!ml_isModelPresent(ctx)) {
+        return -1;
     }
-
-    return input_length;
+    return ctx->input_length;
 }
 
-int ml_getOutputLength() {
-    if (output_length == 0) {
-        ml4f_header_t *ml4f_model = get_ml4f_model();
-        if (ml4f_model == NULL) {
-            return -1;
-        }
-        output_length = ml4f_shape_elements(ml4f_output_shape(ml4f_model));
+int ml_getOutputLength(const ml_model_ctx_t *ctx) {
+    if (!ml_isModelPresent(ctx)) {
+        return -1;
     }
-
-    return output_length;
+    return ctx->output_length;
 }
 
 // TODO: Remove this function and use ml_getLabels instead
-ml_labels_t* ml_getLabels() {
-    static ml_labels_t labels = {
-        .num_labels = 0,
-        .labels = NULL
-    };
-
-    const ml_model_header_t* const model_header = (ml_model_header_t*)MODEL_ADDRESS;
-    if (model_header == NULL) {
-        labels.num_labels = 0;
-        if (labels.labels != NULL) {
-            free(labels.labels);
-            labels.labels = NULL;
-        }
+ml_labels_t* ml_getLabels(ml_model_ctx_t *ctx) {
+    if (!ml_isModelPresent(ctx)) {
         return NULL;
     }
+    return &ctx->labels;
+}
 
-    // Workout the addresses in flash from each label, there are as many strings
-    // as indicated by model_header->number_of_actions
-    const char* flash_labels[model_header->number_of_actions];
-    ml_header_action_t *action = (ml_header_action_t *)&model_header->actions[0];
-    for (int i = 0; i < model_header->number_of_actions; i++) {
-        flash_labels[i] = &action->label[0];
-        // Check the label has a single null terminator at the end
-        for (int j = 0; j < action->label_length - 1; j++) {
-            if (flash_labels[i][j] == '\0') {
-                return NULL;
-            }
-        }
-        // And check the last character is a null terminator
-        if (flash_labels[i][action->label_length - 1] != '\0') {
-            return NULL;
-        }
-        action = (ml_header_action_t *)((uint32_t)action + ml_action_size_without_label + action->label_length);
-        // Next action address is 4 byte aligned
-        action = (ml_header_action_t *)(((uint32_t)action + 3) & ~3);
+int ml_getActionsLength(const ml_model_ctx_t *ctx) {
+    if (!ml_isModelPresent(ctx)) {
+        return -1;
     }
+    return ctx->actions.len;
+}
 
-    // First check if the labels are the same, if not we need to set them again
-    bool set_labels = false;
-    if (labels.num_labels == 0 || labels.labels == NULL) {
-        set_labels = true;
-    } else if (labels.num_labels != model_header->number_of_actions) {
-        set_labels = true;
-    } else {
-        for (size_t i = 0; i < labels.num_labels; i++) {
-            if (labels.labels[i] != flash_labels[i]) {
-                set_labels = true;
-                break;
-            }
-        }
+const char* ml_getActionLabel(const ml_model_ctx_t *ctx, const size_t index) {
+    if (!ml_isModelPresent(ctx) || index >= ctx->actions.len) {
+        return NULL;
     }
-    if (set_labels) {
-        // First clear them out if needed
-        labels.num_labels = 0;
-        if (labels.labels != NULL) {
-            free(labels.labels);
-        }
-        // Then set them to point to the strings in flash
-        labels.labels = (const char **)malloc(model_header->number_of_actions * sizeof(char *));
-        if (labels.labels == NULL) {
-            return NULL;
-        }
-        labels.num_labels = model_header->number_of_actions;
-        for (size_t i = 0; i < labels.num_labels; i++) {
-            labels.labels[i] = flash_labels[i];
-        }
+    return ctx->actions.labels[index];
+}
+
+int ml_getActionLabelLength(const ml_model_ctx_t *ctx, const size_t index) {
+    if (!ml_isModelPresent(ctx) || index >= ctx->actions.len) {
+        return -1;
     }
+    return ctx->actions.label_lengths[index] - 1;
+}
 
-    return &labels;
+float ml_getActionThreshold(const ml_model_ctx_t *ctx, const size_t index) {
+    if (!ml_isModelPresent(ctx) || index >= ctx->actions.len) {
+        return -1;
+    }
+    return ctx->actions.thresholds[index];
 }
 
-ml_actions_t* ml_allocateActions() {
-    const ml_model_header_t* const model_header = (ml_model_header_t*)MODEL_ADDRESS;
-    if (model_header == NULL) {
+ml_actions_t* ml_allocateActions(const ml_model_ctx_t *ctx) {
+    if (!ml_isModelPresent(ctx)) {
         return NULL;
     }
 
     ml_actions_t *actions = (ml_actions_t *)malloc(
-            sizeof(ml_actions_t) + sizeof(ml_action_t) * model_header->number_of_actions);
+            sizeof(ml_actions_t) + sizeof(ml_action_t) * ctx->actions.len);
     if (actions == NULL) {
         return NULL;
     }
-    actions->len = model_header->number_of_actions;
+    actions->len = ctx->actions.len;
     return actions;
 }
 
-bool ml_getActions(ml_actions_t *actions_out) {
-    const ml_model_header_t* const model_header = (ml_model_header_t*)MODEL_ADDRESS;
-    if (model_header == NULL || actions_out == NULL) {
+bool ml_getActions(const ml_model_ctx_t *ctx, ml_actions_t *actions_out) {
+    if (!ml_isModelPresent(ctx) || actions_out == NULL) {
         return false;
     }
-    if (actions_out->len != model_header->number_of_actions) {
+    if (actions_out->len != ctx->actions.len) {
         return false;
     }
 
-    // Iterate through the actions on the header, copy the threshold and add a
-    // pointer to the label stored in flash
-    ml_header_action_t *action = (ml_header_action_t *)&model_header->actions[0];
-    for (int i = 0; i < model_header->number_of_actions; i++) {
-        // Check the label doesn't have any null terminators before the end
-        for (int j = 0; j < action->label_length - 1; j++) {
-            if (action->label[j] == '\0') {
-                return false;
-            }
-        }
-        // And confirm the last character is a null terminator
-        if (action->label[action->label_length - 1] != '\0') {
-            return false;
-        }
-
-        actions_out->action[i].label = &action->label[0];
-        actions_out->action[i].threshold = action->threshold;
-
-        // Locate the next action in flash, which is 4 byte aligned
-        action = (ml_header_action_t *)((uint32_t)action + ml_action_size_without_label + action->label_length);
-        action = (ml_header_action_t *)(((uint32_t)action + 3) & ~3);
+    // The labels point to the strings stored in flash
+    for (size_t i = 0; i < ctx->actions.len; i++) {
+        actions_out->action[i].label = ctx->actions.labels[i];
+        actions_out->action[i].threshold = ctx->actions.thresholds[i];
     }
 
     return true;
 }
 
-ml_predictions_t *ml_allocatePredictions() {
-    int output_size = ml_getOutputLength();
+ml_predictions_t *ml_allocatePredictions(const ml_model_ctx_t *ctx) {
+    int output_size = ml_getOutputLength(ctx);
     if (output_size <= 0) {
         return NULL;
     }
@@ -280,13 +431,17 @@ ml_predictions_t *ml_allocatePredictions() {
     return predictions;
 }
 
-bool ml_predict(const float *input, const size_t in_len, const ml_actions_t *actions, ml_predictions_t *predictions_out) {
+bool ml_predict(ml_model_ctx_t *ctx, const float *input, const size_t in_len, const ml_actions_t *actions, ml_predictions_t *predictions_out) {
+    if (!ml_isModelPresent(ctx)) {
+        return false;
+    }
+    const size_t output_length = ctx->output_length;
     if (actions == NULL || actions->len != output_length ||
             predictions_out == NULL || predictions_out->len != output_length) {
         return false;
     }
 
-    bool success = ml_runModel(input, in_len, (float *)&predictions_out->prediction, output_length);
+    bool success = ml_runModel(ctx, input, in_len, (float *)&predictions_out->prediction, output_length);
     if (!success) {
         return false;
     }
@@ -296,16 +451,59 @@ bool ml_predict(const float *input, const size_t in_len, const ml_actions_t *act
 }
 
 
-bool ml_runModel(const float *input, const size_t in_len, float* individual_predictions, const size_t out_len) {
-    if (input == NULL || individual_predictions == NULL || input_length != in_len || output_length != out_len) {
+bool ml_runModel(ml_model_ctx_t *ctx, const float *input, const size_t in_len, float* individual_predictions, const size_t out_len) {
+    if (!ml_isModelPresent(ctx) || input == NULL || individual_predictions == NULL ||
+            ctx->input_length != in_len || ctx->output_length != out_len) {
         return false;
     }
 
-    ml4f_header_t *ml4f_model = get_ml4f_model();
-    int r = ml4f_full_invoke_arena(ml4f_model, model_arena, input, individual_predictions);
-    if (r != 0) {
+    return invoke_model(ctx, input, individual_predictions);
+}
+
+float* ml_getInputBuffer(ml_model_ctx_t *ctx) {
+    if (!ml_isModelPresent(ctx)) {
+        return NULL;
+    }
+    return (float *)(get_arena(ctx) + get_ml4f_model(ctx)->input_offset);
+}
+
+const float* ml_getOutputBuffer(const ml_model_ctx_t *ctx) {
+    if (!ml_isModelPresent(ctx)) {
+        return NULL;
+    }
+    return (const float *)(get_arena(ctx) + get_ml4f_model(ctx)->output_offset);
+}
+
+bool ml_invoke(ml_model_ctx_t *ctx) {
+    if (!ml_isModelPresent(ctx)) {
+        return false;
+    }
+    return invoke_model(ctx, NULL, NULL);
+}
+
+bool ml_runModelBatch(ml_model_ctx_t *ctx, const float *inputs, const size_t batch, const size_t in_stride,
+                      float *outputs, const size_t out_stride) {
+    if (!ml_isModelPresent(ctx) || inputs == NULL || outputs == NULL ||
+            in_stride < ctx->input_length || out_stride < ctx->output_length) {
+        return false;
+    }
+
+    return invoke_batch(ctx, inputs, batch, in_stride, outputs, out_stride);
+}
+
+bool ml_predictBatch(ml_model_ctx_t *ctx, const float *inputs, const size_t batch, const size_t in_stride,
+                     const ml_actions_t *actions, float *predictions_out, const size_t out_stride, int *indexes_out) {
+    if (!ml_isModelPresent(ctx) || actions == NULL || actions->len != ctx->output_length) {
+        return false;
+    }
+    if (!ml_runModelBatch(ctx, inputs, batch, in_stride, predictions_out, out_stride)) {
         return false;
     }
+    if (indexes_out != NULL) {
+        for (size_t i = 0; i < batch; i++) {
+            indexes_out[i] = ml_calcPrediction(actions, &predictions_out[i * out_stride], ctx->output_length);
+        }
+    }
 
     return true;
 }
@@ -11,6 +11,11 @@
  * This header start and end are 4-byte aligned, with padding zeros at the
  * end if needed, so that the ML4F model is placed directly after it.
  * We call the "full model" the custom header + the ML4F model.
+ *
+ * Each loaded model is kept in its own ml_model_ctx_t, so that several
+ * models can be used at the same time. As inference is synchronous, the
+ * contexts can also share a single ml_arena_t, sized for the largest model,
+ * instead of allocating an arena for each one.
  */
 #pragma once
 
@@ -67,34 +72,120 @@ typedef struct ml_labels_s {
     const char **labels;
 } ml_labels_t;
 
+/**
+ * Actions table parsed and validated from the model header when the model
+ * is set, so that they can be read without walking the header.
+ */
+typedef struct ml_actions_table_s {
+    size_t len;
+    const char **labels;                // Null-terminated strings in the model header
+    float *thresholds;
+    uint8_t *label_lengths;             // Including the null terminator
+} ml_actions_table_t;
+
+/**
+ * An inference arena shared by the models of several contexts. Only one
+ * model can use it at a time, the context running inference is its owner.
+ */
+typedef struct ml_arena_s {
+    uint8_t *buffer;
+    size_t size;                        // Grows to fit the largest model set
+    size_t users;                       // Number of contexts using the arena
+    const struct ml_model_ctx_s *owner; // Context running inference, NULL if none
+} ml_arena_t;
+
+/**
+ * A loaded model, with its arena and the information cached from its header.
+ */
+typedef struct ml_model_ctx_s {
+    const ml_model_header_t *model;     // NULL if a model is not set
+    uint8_t *arena;                     // Arena for this model only, NULL if shared
+    ml_arena_t *shared_arena;           // NULL if the context has its own arena
+    size_t input_length;
+    size_t output_length;
+    ml_actions_table_t actions;
+    ml_labels_t labels;                 // Points to the labels in the actions table
+} ml_model_ctx_t;
+
 typedef struct ml_predictions_s {
     int index;
+    // Not set by ml_predict(), the caller can flag predictions made from
+    // incomplete input data, e.g. from a partially filled samples window
+    bool low_confidence;
     size_t len;
     float prediction[];
 } ml_predictions_t;
 
 /**
- * @brief Set the model to use for inference.
+ * @brief Allocate a context without a model.
+ *
+ * The caller is responsible for freeing it with ml_freeContext().
+ *
+ * @return A pointer to the context, or NULL if it could not be allocated.
+ */
+ml_model_ctx_t* ml_allocateContext();
+
+/**
+ * @brief Free a context and the memory allocated for its model.
+ */
+void ml_freeContext(ml_model_ctx_t *ctx);
+
+/**
+ * @brief Allocate an empty inference arena to be shared between contexts.
  *
+ * The caller is responsible for freeing it with ml_freeSharedArena().
+ *
+ * @return A pointer to the arena, or NULL if it could not be allocated.
+ */
+ml_arena_t* ml_allocateSharedArena();
+
+/**
+ * @brief Free a shared arena.
+ *
+ * @return True if freed, False if a context is still using it.
+ */
+bool ml_freeSharedArena(ml_arena_t *arena);
+
+/**
+ * @brief Use a shared arena to run the models set in a context, instead of
+ * allocating an arena for each model.
+ *
+ * The arena grows as needed when a model is set, and it's used by the
+ * context until the context is freed.
+ *
+ * @param ctx The context, which must not have a model set yet.
+ * @param arena The arena to share, or NULL to allocate one per model.
+ * @return True if set, False if the context already has a model.
+ */
+bool ml_useSharedArena(ml_model_ctx_t *ctx, ml_arena_t *arena);
+
+/**
+ * @brief Set the model to use for inference in a context.
+ *
+ * Any model previously set in the context is replaced.
+ *
+ * @param ctx The context to set the model in.
  * @param model_address The start address of the model.
  * @return True if the model is valid and set, False otherwise.
+ *         If false is returned, the context doesn't have a model.
  */
-bool ml_setModel(const void *model_address);
+bool ml_setModel(ml_model_ctx_t *ctx, const void *model_address);
 
 /**
  * @brief Check if a model is present.
  *
  * @return True if a model is present, False otherwise.
  */
-bool ml_isModelPresent();
+bool ml_isModelPresent(const ml_model_ctx_t *ctx);
 
 /**
  * @brief Get the arena size that has been allocated to run the loaded model.
+ * With a shared arena the allocation can be larger, to fit other models.
  *
  * @return The size, in bytes, of the arena required for the model.
  *         Or -1 if the model is not present.
  */
-int ml_getArenaSize();
+int ml_getArenaSize(const ml_model_ctx_t *ctx);
 
 /**
  * @brief Get the period between samples required for the model.
@@ -102,7 +193,7 @@ int ml_getArenaSize();
  * @return The period between samples required for the model.
  *         Or -1 if the model is not present.
  */
-int ml_getSamplesPeriod();
+int ml_getSamplesPeriod(const ml_model_ctx_t *ctx);
 
 /**
  * @brief Get the number of samples required for the model.
@@ -110,7 +201,7 @@ int ml_getSamplesPeriod();
  * @return The number of samples required for the model.
  *         Or -1 if the model is not present.
  */
-int ml_getSamplesLength();
+int ml_getSamplesLength(const ml_model_ctx_t *ctx);
 
 /**
  * @brief Get the number of dimensions per sample required for the model.
@@ -118,7 +209,7 @@ int ml_getSamplesLength();
  * @return The number of dimensions per sample required for the model.
  *         Or -1 if the model is not present.
  */
-int ml_getSampleDimensions();
+int ml_getSampleDimensions(const ml_model_ctx_t *ctx);
 
 /**
  * @brief Get the input length of the model.
@@ -126,7 +217,7 @@ int ml_getSampleDimensions();
  * @return The number of input elements required for the model.
  *         Or -1 if the model is not present.
  */
-int ml_getInputLength();
+int ml_getInputLength(const ml_model_ctx_t *ctx);
 
 /**
  * @brief Get the output length of the model.
@@ -134,16 +225,49 @@ int ml_getInputLength();
  * @return The number of output elements produced by the model.
  *         Or -1 if the model is not present.
  */
-int ml_getOutputLength();
+int ml_getOutputLength(const ml_model_ctx_t *ctx);
 
 /**
  * @brief Get the model labels.
  *
  * The label pointers point directly to the strings stored in flash.
  *
- * @return A pointer to a ml_labels_t object containing the labels.
+ * @return A pointer to a ml_labels_t object containing the labels,
+ *         valid until a new model is set in the context.
+ *         Or NULL if the model is not present.
+ */
+ml_labels_t* ml_getLabels(ml_model_ctx_t *ctx);
+
+/**
+ * @brief Get the number of actions in the model.
+ *
+ * @return The number of actions, or -1 if the model is not present.
  */
-ml_labels_t* ml_getLabels();
+int ml_getActionsLength(const ml_model_ctx_t *ctx);
+
+/**
+ * @brief Get the label of an action, stored in flash.
+ *
+ * @return The null-terminated label, or NULL if the model is not present
+ *         or the index is out of range.
+ */
+const char* ml_getActionLabel(const ml_model_ctx_t *ctx, const size_t index);
+
+/**
+ * @brief Get the length of the label of an action.
+ *
+ * @return The number of characters without the null terminator, or -1 if
+ *         the model is not present or the index is out of range.
+ */
+int ml_getActionLabelLength(const ml_model_ctx_t *ctx, const size_t index);
+
+/**
+ * @brief Get the threshold of an action.
+ *
+ * @return The min prediction value for the action to be active, or -1 if
+ *         the model is not present or the index is out of range.
+ */
+float ml_getActionThreshold(const ml_model_ctx_t *ctx, const size_t index);
 
 /**
  * @brief Allocate memory for the model actions.
@@ -152,7 +276,7 @@ ml_labels_t* ml_getLabels();
  *
  * @return A pointer to a ml_actions_t object to store the actions.
  */
-ml_actions_t* ml_allocateActions();
+ml_actions_t* ml_allocateActions(const ml_model_ctx_t *ctx);
 
 /**
  * @brief Get the model actions.
@@ -163,10 +287,8 @@ ml_actions_t* ml_allocateActions();
  * @param actions_out A pointer to a ml_actions_t object to store the actions.
  * @return Success state, true if the actions were successfully retrieved,
  *         false otherwise.
- *         If false is returned, the actions_out is partially filled and it
- *         should not be used.
  */
-bool ml_getActions(ml_actions_t *actions_out);
+bool ml_getActions(const ml_model_ctx_t *ctx, ml_actions_t *actions_out);
 
 /**
  * @brief Allocate memory for the model predictions.
@@ -175,31 +297,109 @@ bool ml_getActions(ml_actions_t *actions_out);
  *
  * @return A pointer to a ml_predictions_t object to store the predictions.
  */
-ml_predictions_t *ml_allocatePredictions();
+ml_predictions_t *ml_allocatePredictions(const ml_model_ctx_t *ctx);
 
 /**
  * @brief Run the model and return the index for the predicted action.
  *
+ * @param ctx The context with the model to run.
  * @param actions The actions to use for the prediction.
- * @param input The input data for the model.
+ * @param input The input data for the model, it isn't copied if it's
+ *              already the model input from ml_getInputBuffer().
  * @param in_len The length of the input data.
  * @return The index of the predicted action.
  *        Or -1 if the model is not present, the actions or input length
  *        doesn't match, or the prediction failed.
  */
-bool ml_predict(const float *input, const size_t in_len, const ml_actions_t *actions, ml_predictions_t *predictions_out);
+bool ml_predict(ml_model_ctx_t *ctx, const float *input, const size_t in_len, const ml_actions_t *actions, ml_predictions_t *predictions_out);
 
 /**
  * @brief Run the model and return the individual predictions for each action.
  *
- * @param input The input data for the model.
+ * @param ctx The context with the model to run.
+ * @param input The input data for the model, it isn't copied if it's
+ *              already the model input from ml_getInputBuffer().
  * @param in_len The length of the input data.
  * @param predictions_out An array of floats to store the results.
  * @param out_len The length of the predictions_out array.
  * @return True if the model is present and the model run was successful,
- *         False otherwise.
+ *         False otherwise, e.g. if its shared arena is in use by another
+ *         context running inference at the same time.
+ */
+bool ml_runModel(ml_model_ctx_t *ctx, const float *input, const size_t in_len, float* predictions_out, const size_t out_len);
+
+/**
+ * @brief Get the model input in the arena, so that the input data can be
+ * written in place (e.g. by the data processor) and run with ml_invoke().
+ *
+ * The buffer stays valid until a new model is set in the context, or in
+ * any context using the same shared arena. With a shared arena the input
+ * is also overwritten when another model runs, so it has to be written
+ * right before running the model.
+ *
+ * @return The buffer of ml_getInputLength() floats, or NULL if the model
+ *         is not present.
+ */
+float* ml_getInputBuffer(ml_model_ctx_t *ctx);
+
+/**
+ * @brief Get the model output in the arena, to read the individual
+ * predictions of the last ml_invoke() without copying them.
+ *
+ * Valid under the same conditions as ml_getInputBuffer(), until the model
+ * (or any model sharing the arena) runs again.
+ *
+ * @return The buffer of ml_getOutputLength() floats, or NULL if the model
+ *         is not present.
+ */
+const float* ml_getOutputBuffer(const ml_model_ctx_t *ctx);
+
+/**
+ * @brief Run the model on the input already written to ml_getInputBuffer(),
+ * with the results in ml_getOutputBuffer().
+ *
+ * @return True if the model is present and the model run was successful,
+ *         False otherwise, as for ml_runModel().
+ */
+bool ml_invoke(ml_model_ctx_t *ctx);
+
+/**
+ * @brief Run the model on a batch of inputs, e.g. to replay recorded data or
+ * to catch up with a backlog of windows.
+ *
+ * The arguments are validated once and the arena is taken for the whole
+ * batch, so it's faster than calling ml_runModel() for each input.
+ *
+ * @param ctx The context with the model to run.
+ * @param inputs The batch of input data, each one of ml_getInputLength().
+ * @param batch The number of inputs in the batch.
+ * @param in_stride Number of floats from the start of an input to the next,
+ *                  at least ml_getInputLength().
+ * @param outputs Array where the individual predictions of each input are
+ *                stored.
+ * @param out_stride Number of floats from the start of an output to the
+ *                   next, at least ml_getOutputLength().
+ * @return True if the model is present and all the model runs were
+ *         successful, False otherwise. Outputs already written are kept.
+ */
+bool ml_runModelBatch(ml_model_ctx_t *ctx, const float *inputs, const size_t batch, const size_t in_stride,
+                      float *outputs, const size_t out_stride);
+
+/**
+ * @brief Run the model on a batch of inputs, as ml_runModelBatch(), and
+ * calculate the predicted action for each one.
+ *
+ * @param actions The actions to use for the prediction.
+ * @param predictions_out Array where the individual predictions of each
+ *                        input are stored, with out_stride as in
+ *                        ml_runModelBatch().
+ * @param indexes_out Array of batch elements to store the index of each
+ *                    predicted action, -1 if none. Can be NULL.
+ * @return True if the model is present, the actions length matches and
+ *         the model runs were successful, False otherwise.
  */
-bool ml_runModel(const float *input, const size_t in_len, float* predictions_out, const size_t out_len);
+bool ml_predictBatch(ml_model_ctx_t *ctx, const float *inputs, const size_t batch, const size_t in_stride,
+                     const ml_actions_t *actions, float *predictions_out, const size_t out_stride, int *indexes_out);
 
 /**
  * @brief Calculate the overall prediction based on the actions thresholds.
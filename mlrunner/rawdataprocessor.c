@@ -0,0 +1,381 @@
+/**
+ * @brief Data Processor that outputs the raw window of samples, as used by the
+ * Model Example 2 included in mlrunner.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ *
+ * @details
+ * The samples are collected in consecutive windows. When double buffered,
+ * a full window is handed over to the processed side and recording
+ * continues on the second buffer, unless the processed side is still in use,
+ * in which case the window being recorded is overwritten.
+ *
+ * As the windows don't overlap the hop is always the window length.
+ */
+#include <string.h>
+#include "mldataprocessor.h"
+#include "mldpresampler.h"
+
+
+typedef struct {
+    float *accData;             // Buffer being recorded
+    float *accDataReady;        // Last full window, or same as accData if not double buffered
+    bool accDataAvailable;
+    bool accDataFrozen;
+    bool accDataFilled;         // At least one window has been recorded
+    int accWindowsReady;        // New windows not reported by isDataReady() yet
+    float *accScale;
+    float *accOutput;           // MlDataProcessorConfig_t.output_buffer, NULL if not set
+    int accDimensions;
+    int accDataSize;
+    int accDataIndex;
+    MldpResampler_t *resampler; // NULL if the samples are recorded at the model period
+    float *resampled;
+    MldpRegrid_t *regrid;       // Grid for the samples with timestamps, NULL without a period
+} RawDataProcessor_t;
+
+
+static MldpHandle_t rawDataProcessor_init(const MlDataProcessorConfig_t* config, MldpReturn_t *result);
+static void rawDataProcessor_deinit(MldpHandle_t handle);
+static MldpReturn_t rawDataProcessor_recordData(MldpHandle_t handle, const float *samples, const int elements);
+static MldpReturn_t rawDataProcessor_recordDataInt16(MldpHandle_t handle, const int16_t *samples, const int elements);
+static bool rawDataProcessor_isDataReady(MldpHandle_t handle, int *missed_hops);
+static float* rawDataProcessor_getProcessedData(MldpHandle_t handle);
+static size_t rawDataProcessor_getProcessedDataSize(MldpHandle_t handle);
+static MldpReturn_t rawDataProcessor_snapshot(MldpHandle_t handle);
+static void rawDataProcessor_commit(MldpHandle_t handle);
+static bool rawDataProcessor_isWindowPartial(MldpHandle_t handle);
+static MldpReturn_t rawDataProcessor_recordDataTimed(MldpHandle_t handle, const float *samples, const int elements, const uint32_t timestamp);
+static MldpReturn_t rawDataProcessor_recordDataTimedInt16(MldpHandle_t handle, const int16_t *samples, const int elements, const uint32_t timestamp);
+static MldpReturn_t rawDataProcessor_getJitter(MldpHandle_t handle, MldpJitter_t *jitter, const bool reset);
+static MldpReturn_t rawDataProcessor_getSamples(MldpHandle_t handle, float *data_out, const int dimensions, const int max_samples, int *samples);
+static MldpReturn_t rawDataProcessor_warmStart(MldpHandle_t handle, const MlDataProcessor_t *previous, MldpHandle_t previous_handle);
+
+
+static MldpReturn_t allocate(RawDataProcessor_t *dp, const MlDataProcessorConfig_t* config) {
+    // Only the recorded samples are output, so there are no derived channels
+    if (config->samples <= 0 || config->dimensions <= 0 || config->output_length <= 0 ||
+            config->derived_size != 0) {
+        return MLDP_ERROR_CONFIG;
+    }
+    if (config->input_period < 0 || (config->input_period > 0 && config->samples_period <= 0)) {
+        return MLDP_ERROR_CONFIG;
+    }
+    // The model input is always a full window
+    if (config->hop != 0 && config->hop != config->samples) {
+        return MLDP_ERROR_CONFIG;
+    }
+    if (config->min_fill != 0) {
+        return MLDP_ERROR_CONFIG;
+    }
+
+    dp->accDataIndex = 0;
+    dp->accOutput = config->output_buffer;
+    dp->accDimensions = config->dimensions;
+    dp->accDataSize = config->samples * config->dimensions;
+
+    if (config->output_length != dp->accDataSize) {
+        return MLDP_ERROR_CONFIG;
+    }
+
+    dp->accData = (float*)malloc(dp->accDataSize * sizeof(float));
+    dp->accScale = (float*)malloc(dp->accDimensions * sizeof(float));
+    if (dp->accData == NULL || dp->accScale == NULL) {
+        return MLDP_ERROR_ALLOC;
+    }
+    // The window is the model input, so it is always stored as float
+    for (int i = 0; i < dp->accDimensions; i++) {
+        dp->accScale[i] = config->scale != NULL ? config->scale[i] : 1.0f;
+    }
+    if (config->double_buffered) {
+        dp->accDataReady = (float*)malloc(dp->accDataSize * sizeof(float));
+        if (dp->accDataReady == NULL) {
+            return MLDP_ERROR_ALLOC;
+        }
+    } else {
+        dp->accDataReady = dp->accData;
+    }
+    if (config->input_period > 0 && config->input_period != config->samples_period) {
+        dp->resampler = (MldpResampler_t*)calloc(1, sizeof(MldpResampler_t));
+        if (dp->resampler == NULL) {
+            return MLDP_ERROR_ALLOC;
+        }
+        MldpReturn_t rs_result = mldpResampler_init(
+            dp->resampler, dp->accDimensions, config->input_period, config->samples_period);
+        if (rs_result != MLDP_SUCCESS) {
+            return rs_result;
+        }
+        dp->resampled = (float*)malloc(
+            mldpResampler_maxOutputs(dp->resampler) * dp->accDimensions * sizeof(float));
+        if (dp->resampled == NULL) {
+            return MLDP_ERROR_ALLOC;
+        }
+    }
+    const int grid_period = config->input_period > 0 ? config->input_period : config->samples_period;
+    if (grid_period > 0) {
+        dp->regrid = (MldpRegrid_t*)calloc(1, sizeof(MldpRegrid_t));
+        if (dp->regrid == NULL) {
+            return MLDP_ERROR_ALLOC;
+        }
+        MldpReturn_t rg_result = mldpRegrid_init(dp->regrid, dp->accDimensions, grid_period);
+        if (rg_result != MLDP_SUCCESS) {
+            return rg_result;
+        }
+    }
+
+    return MLDP_SUCCESS;
+}
+
+MldpHandle_t rawDataProcessor_init(const MlDataProcessorConfig_t* config, MldpReturn_t *result) {
+    RawDataProcessor_t *dp = (RawDataProcessor_t*)calloc(1, sizeof(RawDataProcessor_t));
+    MldpReturn_t init_result = dp == NULL ? MLDP_ERROR_ALLOC : allocate(dp, config);
+    if (result != NULL) {
+        *result = init_result;
+    }
+    if (init_result != MLDP_SUCCESS) {
+        rawDataProcessor_deinit((MldpHandle_t)dp);
+        return NULL;
+    }
+    return (MldpHandle_t)dp;
+}
+
+void rawDataProcessor_deinit(MldpHandle_t handle) {
+    RawDataProcessor_t *dp = (RawDataProcessor_t*)handle;
+    if (dp == NULL) return;
+
+    if (dp->accDataReady != dp->accData) {
+        free(dp->accDataReady);
+    }
+    free(dp->accData);
+    free(dp->accScale);
+    if (dp->resampler != NULL) mldpResampler_deinit(dp->resampler);
+    free(dp->resampler);
+    free(dp->resampled);
+    if (dp->regrid != NULL) mldpRegrid_deinit(dp->regrid);
+    free(dp->regrid);
+    free(dp);
+}
+
+// Store a sample at the model period
+static void store_sample(RawDataProcessor_t *dp, const float *samples) {
+    // With a single buffer the data is only ready until it starts to be overwritten
+    if (dp->accDataReady == dp->accData) {
+        dp->accDataAvailable = false;
+    }
+    for (int i = 0; i < dp->accDimensions; i++) {
+        dp->accData[dp->accDataIndex++] = samples[i];
+    }
+    if (dp->accDataIndex >= dp->accDataSize) {
+        dp->accDataIndex = 0;
+        // Swap buffers, unless the other one is frozen and has to be kept
+        if (dp->accDataReady != dp->accData && !dp->accDataFrozen) {
+            float *full = dp->accData;
+            dp->accData = dp->accDataReady;
+            dp->accDataReady = full;
+        }
+        dp->accDataAvailable = !dp->accDataFrozen || dp->accDataReady == dp->accData;
+        dp->accDataFilled = true;
+        dp->accWindowsReady++;
+    }
+}
+
+MldpReturn_t rawDataProcessor_recordData(MldpHandle_t handle, const float* samples, const int elements) {
+    RawDataProcessor_t *dp = (RawDataProcessor_t*)handle;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    // Only record data if the number of elements is a multiple of the sample dimensions
+    if (elements <= 0 || elements % dp->accDimensions != 0) return MLDP_ERROR_CONFIG;
+
+    const int number_of_samples = elements / dp->accDimensions;
+    for (int s_i = 0; s_i < number_of_samples; s_i++) {
+        const float *sample = &samples[s_i * dp->accDimensions];
+        if (dp->resampler == NULL) {
+            store_sample(dp, sample);
+            continue;
+        }
+        const int outputs = mldpResampler_push(dp->resampler, sample, dp->resampled);
+        for (int o_i = 0; o_i < outputs; o_i++) {
+            store_sample(dp, &dp->resampled[o_i * dp->accDimensions]);
+        }
+    }
+    return MLDP_SUCCESS;
+}
+
+MldpReturn_t rawDataProcessor_recordDataInt16(MldpHandle_t handle, const int16_t* samples, const int elements) {
+    RawDataProcessor_t *dp = (RawDataProcessor_t*)handle;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    if (elements <= 0 || elements % dp->accDimensions != 0) return MLDP_ERROR_CONFIG;
+
+    float converted[dp->accDimensions];
+    for (int s_i = 0; s_i < elements; s_i += dp->accDimensions) {
+        for (int i = 0; i < dp->accDimensions; i++) {
+            converted[i] = samples[s_i + i] * dp->accScale[i];
+        }
+        rawDataProcessor_recordData(handle, converted, dp->accDimensions);
+    }
+    return MLDP_SUCCESS;
+}
+
+MldpReturn_t rawDataProcessor_recordDataTimed(MldpHandle_t handle, const float* samples, const int elements, const uint32_t timestamp) {
+    RawDataProcessor_t *dp = (RawDataProcessor_t*)handle;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    if (elements != dp->accDimensions || dp->regrid == NULL) return MLDP_ERROR_CONFIG;
+    if (!mldpRegrid_push(dp->regrid, samples, timestamp)) return MLDP_ERROR;
+
+    float sample[dp->accDimensions];
+    while (mldpRegrid_next(dp->regrid, sample)) {
+        rawDataProcessor_recordData(handle, sample, elements);
+    }
+    return MLDP_SUCCESS;
+}
+
+MldpReturn_t rawDataProcessor_recordDataTimedInt16(MldpHandle_t handle, const int16_t* samples, const int elements, const uint32_t timestamp) {
+    RawDataProcessor_t *dp = (RawDataProcessor_t*)handle;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    if (elements != dp->accDimensions) return MLDP_ERROR_CONFIG;
+
+    // The window is stored as float, so the samples are only scaled once
+    float converted[dp->accDimensions];
+    for (int i = 0; i < dp->accDimensions; i++) {
+        converted[i] = samples[i] * dp->accScale[i];
+    }
+    return rawDataProcessor_recordDataTimed(handle, converted, elements, timestamp);
+}
+
+MldpReturn_t rawDataProcessor_getJitter(MldpHandle_t handle, MldpJitter_t *jitter, const bool reset) {
+    RawDataProcessor_t *dp = (RawDataProcessor_t*)handle;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    if (dp->regrid == NULL) return MLDP_ERROR_CONFIG;
+
+    *jitter = dp->regrid->jitter;
+    if (reset) mldpRegrid_resetJitter(dp->regrid);
+    return MLDP_SUCCESS;
+}
+
+bool rawDataProcessor_isDataReady(MldpHandle_t handle, int *missed_hops) {
+    RawDataProcessor_t *dp = (RawDataProcessor_t*)handle;
+    if (missed_hops != NULL) *missed_hops = 0;
+    if (dp == NULL) return false;
+    if (!dp->accDataAvailable || dp->accDataFrozen || dp->accWindowsReady == 0) return false;
+
+    if (missed_hops != NULL) *missed_hops = dp->accWindowsReady - 1;
+    dp->accWindowsReady = 0;
+    return true;
+}
+
+float* rawDataProcessor_getProcessedData(MldpHandle_t handle) {
+    RawDataProcessor_t *dp = (RawDataProcessor_t*)handle;
+    if (dp == NULL) return NULL;
+    // Double buffered data has to come from a snapshot
+    if (dp->accDataReady != dp->accData && !dp->accDataFrozen) return NULL;
+    // The window can't be recorded in the output buffer, as it would be
+    // overwritten while the model runs
+    if (dp->accOutput != NULL) {
+        memcpy(dp->accOutput, dp->accDataReady, dp->accDataSize * sizeof(float));
+        return dp->accOutput;
+    }
+    return dp->accDataReady;
+}
+
+size_t rawDataProcessor_getProcessedDataSize(MldpHandle_t handle) {
+    const RawDataProcessor_t *dp = (const RawDataProcessor_t*)handle;
+    if (dp == NULL) return 0;
+    return dp->accDataSize;
+}
+
+MldpReturn_t rawDataProcessor_snapshot(MldpHandle_t handle) {
+    RawDataProcessor_t *dp = (RawDataProcessor_t*)handle;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    if (dp->accDataReady == dp->accData) return MLDP_SUCCESS;
+    if (dp->accDataFrozen) return MLDP_ERROR_BUSY;
+    if (!dp->accDataAvailable) return MLDP_ERROR_NODATA;
+
+    dp->accDataFrozen = true;
+    dp->accDataAvailable = false;
+    return MLDP_SUCCESS;
+}
+
+void rawDataProcessor_commit(MldpHandle_t handle) {
+    RawDataProcessor_t *dp = (RawDataProcessor_t*)handle;
+    if (dp == NULL) return;
+    dp->accDataFrozen = false;
+}
+
+MldpReturn_t rawDataProcessor_getSamples(MldpHandle_t handle, float *data_out, const int dimensions, const int max_samples, int *samples) {
+    const RawDataProcessor_t *dp = (const RawDataProcessor_t*)handle;
+    if (samples != NULL) *samples = 0;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    if (dimensions != dp->accDimensions || max_samples < 0) return MLDP_ERROR_CONFIG;
+
+    // The window being recorded follows the previous one, which is the rest
+    // of the same buffer if not double buffered. A frozen window is older
+    // than that, as the ones recorded in the meantime have been dropped.
+    const int window_samples = dp->accDataSize / dp->accDimensions;
+    const int recording = dp->accDataIndex / dp->accDimensions;
+    const float *previous = dp->accData;
+    int previous_samples = 0;
+    if (dp->accDataFilled && dp->accDataReady == dp->accData) {
+        previous = &dp->accData[dp->accDataIndex];
+        previous_samples = window_samples - recording;
+    } else if (dp->accDataFilled && !dp->accDataFrozen) {
+        previous = dp->accDataReady;
+        previous_samples = window_samples;
+    }
+
+    const int available = previous_samples + recording;
+    const int count = max_samples < available ? max_samples : available;
+    const int from_recording = count < recording ? count : recording;
+    const int from_previous = count - from_recording;
+    memcpy(data_out, &previous[(previous_samples - from_previous) * dp->accDimensions],
+           from_previous * dp->accDimensions * sizeof(float));
+    memcpy(&data_out[from_previous * dp->accDimensions], &dp->accData[(recording - from_recording) * dp->accDimensions],
+           from_recording * dp->accDimensions * sizeof(float));
+    if (samples != NULL) *samples = count;
+
+    return MLDP_SUCCESS;
+}
+
+MldpReturn_t rawDataProcessor_warmStart(MldpHandle_t handle, const MlDataProcessor_t *previous, MldpHandle_t previous_handle) {
+    RawDataProcessor_t *dp = (RawDataProcessor_t*)handle;
+    if (dp == NULL) return MLDP_ERROR_NOINIT;
+    if (previous == NULL || previous_handle == NULL) return MLDP_ERROR_CONFIG;
+    if (dp->accDataIndex != 0 || dp->accDataFilled) return MLDP_ERROR;
+
+    float *samples = (float*)malloc(dp->accDataSize * sizeof(float));
+    if (samples == NULL) return MLDP_ERROR_ALLOC;
+    int count = 0;
+    MldpReturn_t result = previous->getSamples(
+        previous_handle, samples, dp->accDimensions, dp->accDataSize / dp->accDimensions, &count);
+    // Already at the model period, so they skip the resampler
+    for (int s_i = 0; result == MLDP_SUCCESS && s_i < count; s_i++) {
+        store_sample(dp, &samples[s_i * dp->accDimensions]);
+    }
+    free(samples);
+
+    return result;
+}
+
+bool rawDataProcessor_isWindowPartial(MldpHandle_t handle) {
+    // The model input is always a full window
+    (void)handle;
+    return false;
+}
+
+const MlDataProcessor_t mlRawDataProcessor = {
+    .init = rawDataProcessor_init,
+    .deinit = rawDataProcessor_deinit,
+    .recordData = rawDataProcessor_recordData,
+    .recordDataInt16 = rawDataProcessor_recordDataInt16,
+    .isDataReady = rawDataProcessor_isDataReady,
+    .getProcessedData = rawDataProcessor_getProcessedData,
+    .getProcessedDataSize = rawDataProcessor_getProcessedDataSize,
+    .snapshot = rawDataProcessor_snapshot,
+    .commit = rawDataProcessor_commit,
+    .getSamples = rawDataProcessor_getSamples,
+    .warmStart = rawDataProcessor_warmStart,
+    .isWindowPartial = rawDataProcessor_isWindowPartial,
+    .recordDataTimed = rawDataProcessor_recordDataTimed,
+    .recordDataTimedInt16 = rawDataProcessor_recordDataTimedInt16,
+    .getJitter = rawDataProcessor_getJitter,
+};
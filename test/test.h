@@ -0,0 +1,34 @@
+/**
+ * @brief Minimal helpers for the host tests.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int test_failures = 0;
+
+#define CHECK(condition)                                                     \
+    do {                                                                     \
+        if (!(condition)) {                                                  \
+            printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);    \
+            test_failures++;                                                 \
+        }                                                                    \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+    CHECK(fabsf((float)(actual) - (float)(expected)) <= (tolerance))
+
+#define RUN_TEST(test_fn)                       \
+    do {                                        \
+        const int failures = test_failures;     \
+        test_fn();                              \
+        printf("  %s %s\n", test_failures == failures ? "ok  " : "FAIL", #test_fn); \
+    } while (0)
+
+#define TEST_RESULT() (test_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE)
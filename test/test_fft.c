@@ -0,0 +1,115 @@
+/**
+ * @brief Spectral filters and the FFT they use.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ */
+#include <string.h>
+#include "mldataprocessor.h"
+#include "mldpfft.h"
+#include "test.h"
+
+#define BANDS 8
+
+// Deterministic pseudo random value from -1 to 1
+static float random_value(uint32_t *state) {
+    *state = *state * 1664525u + 1013904223u;
+    return (float)(int32_t)*state / 2147483648.0f;
+}
+
+// Naive DFT band energies, as documented for filterBandEnergy()
+static void dft_band_energies(const float *data, const int in_size, float *bands, const int out_size) {
+    const int size = mldpFft_size(in_size);
+    float mean = 0;
+    for (int i = 0; i < in_size; i++) mean += data[i];
+    mean /= in_size;
+    const int bins = size / 2;
+    for (int b_i = 0; b_i < out_size; b_i++) {
+        double energy = 0;
+        for (int k = 1 + b_i * bins / out_size; k < 1 + (b_i + 1) * bins / out_size; k++) {
+            double re = 0, im = 0;
+            for (int n = 0; n < in_size; n++) {
+                const double angle = -2.0 * M_PI * k * n / size;
+                re += (data[n] - mean) * cos(angle);
+                im += (data[n] - mean) * sin(angle);
+            }
+            energy += re * re + im * im;
+        }
+        bands[b_i] = (float)(energy / ((double)size * size));
+    }
+}
+
+static float total(const float *bands) {
+    float sum = 0;
+    for (int i = 0; i < BANDS; i++) sum += bands[i];
+    return sum;
+}
+
+static void test_float_matches_dft(void) {
+    uint32_t state = 1;
+    const int sizes[] = { 16, 50, 64, 200 };
+    for (size_t s_i = 0; s_i < sizeof(sizes) / sizeof(sizes[0]); s_i++) {
+        float data[256], expected[BANDS], actual[BANDS];
+        for (int i = 0; i < sizes[s_i]; i++) data[i] = random_value(&state);
+        dft_band_energies(data, sizes[s_i], expected, BANDS);
+        CHECK(filterBandEnergy(data, sizes[s_i], actual, BANDS) == MLDP_SUCCESS);
+        for (int b_i = 0; b_i < BANDS; b_i++) {
+            CHECK_NEAR(actual[b_i], expected[b_i], 1e-4f * total(expected));
+        }
+    }
+}
+
+// Full scale windows are the worst case for the fixed point butterflies
+static void test_q15_matches_float_full_scale(void) {
+    uint32_t state = 7;
+    int worst_window = -1;
+    float worst_error = 0;
+    for (int w_i = 0; w_i < 500; w_i++) {
+        float data[64], expected[BANDS], actual[BANDS];
+        for (int i = 0; i < 64; i++) {
+            // Random values at the extremes, and random full scale noise
+            const float value = random_value(&state);
+            data[i] = w_i % 2 == 0 ? (value < 0 ? -1.0f : 1.0f) : value;
+        }
+        CHECK(filterBandEnergy(data, 64, expected, BANDS) == MLDP_SUCCESS);
+        CHECK(filterBandEnergyQ15(data, 64, actual, BANDS) == MLDP_SUCCESS);
+        const float scale = total(expected);
+        for (int b_i = 0; b_i < BANDS; b_i++) {
+            const float error = fabsf(actual[b_i] - expected[b_i]) / scale;
+            if (error > worst_error) {
+                worst_error = error;
+                worst_window = w_i;
+            }
+        }
+    }
+    if (worst_error > 0.01f) {
+        printf("  worst window %d, error %.1f%% of the total energy\n", worst_window, worst_error * 100);
+    }
+    CHECK(worst_error <= 0.01f);
+}
+
+// The window of the raw samples model, 250 samples of 3 dimensions
+static void test_large_window(void) {
+    uint32_t state = 3;
+    float data[MLDP_FFT_MAX_SIZE + 1], expected[BANDS], actual[BANDS];
+    for (int i = 0; i <= MLDP_FFT_MAX_SIZE; i++) data[i] = random_value(&state);
+    CHECK(mldpFft_size(750) == 1024);
+    dft_band_energies(data, 750, expected, BANDS);
+    CHECK(filterBandEnergy(data, 750, actual, BANDS) == MLDP_SUCCESS);
+    for (int b_i = 0; b_i < BANDS; b_i++) {
+        CHECK_NEAR(actual[b_i], expected[b_i], 1e-4f * total(expected));
+    }
+    CHECK(filterBandEnergyQ15(data, 750, actual, BANDS) == MLDP_SUCCESS);
+    for (int b_i = 0; b_i < BANDS; b_i++) {
+        CHECK_NEAR(actual[b_i], expected[b_i], 0.01f * total(expected));
+    }
+    CHECK(filterBandEnergy(data, MLDP_FFT_MAX_SIZE + 1, actual, BANDS) == MLDP_ERROR_CONFIG);
+}
+
+int main(void) {
+    RUN_TEST(test_float_matches_dft);
+    RUN_TEST(test_large_window);
+    RUN_TEST(test_q15_matches_float_full_scale);
+    return TEST_RESULT();
+}
@@ -0,0 +1,108 @@
+/**
+ * @brief Samples recorded through the lock-free queue.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ */
+#include <string.h>
+#include "mldpqueue.h"
+#include "test.h"
+
+#define SAMPLES 8
+#define DIMENSIONS 3
+
+static const MlDataFilters_t filters[] = {
+    { .out_size = SAMPLES, .filter = filterPassThrough },
+};
+
+static MldpHandle_t init_processor(const MlDataProcessor_t *processor) {
+    const MlDataProcessorConfig_t config = {
+        .samples = SAMPLES,
+        .dimensions = DIMENSIONS,
+        .output_length = SAMPLES * DIMENSIONS,
+        .filter_size = processor == &mlFilterDataProcessor ? 1 : 0,
+        .filters = filters,
+    };
+    return processor->init(&config, NULL);
+}
+
+static void push_samples(MldpQueue_t *queue, const int first, const int count) {
+    for (int s_i = first; s_i < first + count; s_i++) {
+        const int16_t sample[DIMENSIONS] = { s_i, -s_i, 2 * s_i };
+        CHECK(mldpQueue_push(queue, sample));
+    }
+}
+
+// Same samples recorded directly, one at a time, and through the queue,
+// including runs that wrap around the end of the queue buffer
+static void check_drain(const MlDataProcessor_t *processor) {
+    MldpQueue_t queue;
+    CHECK(mldpQueue_init(&queue, DIMENSIONS, 4) == MLDP_SUCCESS);
+    MldpHandle_t direct = init_processor(processor);
+    MldpHandle_t queued = init_processor(processor);
+    CHECK(direct != NULL && queued != NULL);
+
+    int pushed = 0;
+    const int runs[] = { 3, 4, 2, 3, 4 };
+    for (size_t r_i = 0; r_i < sizeof(runs) / sizeof(runs[0]); r_i++) {
+        push_samples(&queue, pushed, runs[r_i]);
+        CHECK(mldpQueue_drain(&queue, processor, queued) == runs[r_i]);
+        for (int s_i = pushed; s_i < pushed + runs[r_i]; s_i++) {
+            const int16_t sample[DIMENSIONS] = { s_i, -s_i, 2 * s_i };
+            CHECK(processor->recordDataInt16(direct, sample, DIMENSIONS) == MLDP_SUCCESS);
+        }
+        pushed += runs[r_i];
+    }
+    CHECK(mldpQueue_overruns(&queue) == 0);
+
+    CHECK(processor->isDataReady(direct, NULL));
+    CHECK(processor->isDataReady(queued, NULL));
+    const float *expected = processor->getProcessedData(direct);
+    const float *actual = processor->getProcessedData(queued);
+    CHECK(expected != NULL && actual != NULL);
+    if (expected != NULL && actual != NULL) {
+        CHECK(memcmp(expected, actual, SAMPLES * DIMENSIONS * sizeof(float)) == 0);
+    }
+
+    processor->deinit(direct);
+    processor->deinit(queued);
+    mldpQueue_deinit(&queue);
+}
+
+static void test_drain_filter_processor(void) {
+    check_drain(&mlFilterDataProcessor);
+}
+
+static void test_drain_raw_processor(void) {
+    check_drain(&mlRawDataProcessor);
+}
+
+// A processor that rejects the samples must not leave them in the queue
+static void test_drain_error_empties_queue(void) {
+    MldpQueue_t queue;
+    CHECK(mldpQueue_init(&queue, DIMENSIONS - 1, 4) == MLDP_SUCCESS);
+    MldpHandle_t handle = init_processor(&mlRawDataProcessor);
+
+    const int16_t sample[DIMENSIONS - 1] = { 1, 2 };
+    // 4 elements are not a multiple of the processor dimensions
+    for (int i = 0; i < 2; i++) {
+        CHECK(mldpQueue_push(&queue, sample));
+    }
+    CHECK(mldpQueue_drain(&queue, &mlRawDataProcessor, handle) == MLDP_ERROR_CONFIG);
+    CHECK(mldpQueue_drain(&queue, &mlRawDataProcessor, handle) == 0);
+    for (int i = 0; i < 4; i++) {
+        CHECK(mldpQueue_push(&queue, sample));
+    }
+    CHECK(mldpQueue_overruns(&queue) == 0);
+
+    mlRawDataProcessor.deinit(handle);
+    mldpQueue_deinit(&queue);
+}
+
+int main(void) {
+    RUN_TEST(test_drain_filter_processor);
+    RUN_TEST(test_drain_raw_processor);
+    RUN_TEST(test_drain_error_empties_queue);
+    return TEST_RESULT();
+}
@@ -0,0 +1,201 @@
+/**
+ * @brief When the data processors report a new window, and from which samples.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ */
+#include "mldataprocessor.h"
+#include "test.h"
+
+static const MlDataFilters_t ml_trainer_filters[] = {
+    { .out_size = 1, .filter = filterMax },
+    { .out_size = 1, .filter = filterMean },
+    { .out_size = 1, .filter = filterMin },
+    { .out_size = 1, .filter = filterStdDev },
+    { .out_size = 1, .filter = filterPeaks },
+    { .out_size = 1, .filter = filterTotalAcc },
+    { .out_size = 1, .filter = filterZcr },
+    { .out_size = 1, .filter = filterRms },
+};
+static const int ml_trainer_filters_len = sizeof(ml_trainer_filters) / sizeof(ml_trainer_filters[0]);
+
+static const MlDataFilters_t max_filter[] = {
+    { .out_size = 1, .filter = filterMax },
+};
+
+static float sample_value(const int i) {
+    return (float)((i * 7) % 11) - 5.0f;
+}
+
+static MldpHandle_t init_filter_processor(const int samples, const int hop, const float min_fill,
+                                          const bool double_buffered, const MlDataFilters_t *filters,
+                                          const int filter_size, MldpReturn_t *result) {
+    const MlDataProcessorConfig_t config = {
+        .samples = samples,
+        .dimensions = 1,
+        .output_length = filter_size,
+        .filter_size = filter_size,
+        .filters = filters,
+        .incremental = true,
+        .double_buffered = double_buffered,
+        .hop = hop,
+        .min_fill = min_fill,
+    };
+    return mlFilterDataProcessor.init(&config, result);
+}
+
+// First window when full, then one every hop
+static void test_hop(void) {
+    MldpHandle_t handle = init_filter_processor(10, 3, 0, false, max_filter, 1, NULL);
+    CHECK(handle != NULL);
+    for (int i = 0; i < 30; i++) {
+        const float value = sample_value(i);
+        mlFilterDataProcessor.recordData(handle, &value, 1);
+        int missed = -1;
+        const bool ready = mlFilterDataProcessor.isDataReady(handle, &missed);
+        CHECK(ready == (i >= 9 && (i - 9) % 3 == 0));
+        CHECK(missed == 0);
+    }
+    mlFilterDataProcessor.deinit(handle);
+}
+
+// Windows not polled in time are reported as missed hops
+static void test_missed_hops(void) {
+    MldpHandle_t handle = init_filter_processor(10, 2, 0, false, max_filter, 1, NULL);
+    CHECK(handle != NULL);
+    for (int i = 0; i < 10; i++) {
+        const float value = sample_value(i);
+        mlFilterDataProcessor.recordData(handle, &value, 1);
+    }
+    int missed = -1;
+    CHECK(mlFilterDataProcessor.isDataReady(handle, &missed));
+    CHECK(missed == 0);
+    // 7 more samples are 3 new windows, with a sample left for the next one
+    for (int i = 10; i < 17; i++) {
+        const float value = sample_value(i);
+        mlFilterDataProcessor.recordData(handle, &value, 1);
+    }
+    CHECK(mlFilterDataProcessor.isDataReady(handle, &missed));
+    CHECK(missed == 2);
+    CHECK(!mlFilterDataProcessor.isDataReady(handle, &missed));
+    CHECK(missed == 0);
+    mlFilterDataProcessor.deinit(handle);
+}
+
+// A snapshot in use holds the reports back, and they are then missed
+static void test_missed_hops_during_snapshot(void) {
+    MldpHandle_t handle = init_filter_processor(4, 1, 0, true, max_filter, 1, NULL);
+    CHECK(handle != NULL);
+    int missed = -1;
+    for (int i = 0; i < 4; i++) {
+        const float value = sample_value(i);
+        mlFilterDataProcessor.recordData(handle, &value, 1);
+    }
+    CHECK(mlFilterDataProcessor.isDataReady(handle, &missed));
+    CHECK(mlFilterDataProcessor.snapshot(handle) == MLDP_SUCCESS);
+    for (int i = 4; i < 7; i++) {
+        const float value = sample_value(i);
+        mlFilterDataProcessor.recordData(handle, &value, 1);
+        CHECK(!mlFilterDataProcessor.isDataReady(handle, NULL));
+    }
+    mlFilterDataProcessor.commit(handle);
+    CHECK(mlFilterDataProcessor.isDataReady(handle, &missed));
+    CHECK(missed == 2);
+    mlFilterDataProcessor.deinit(handle);
+}
+
+// The raw processor reports consecutive windows
+static void test_raw_windows(void) {
+    const MlDataProcessorConfig_t config = {
+        .samples = 5,
+        .dimensions = 1,
+        .output_length = 5,
+    };
+    MldpHandle_t handle = mlRawDataProcessor.init(&config, NULL);
+    CHECK(handle != NULL);
+    for (int i = 0; i < 20; i++) {
+        const float value = sample_value(i);
+        mlRawDataProcessor.recordData(handle, &value, 1);
+        CHECK(mlRawDataProcessor.isDataReady(handle, NULL) == (i % 5 == 4));
+    }
+    mlRawDataProcessor.deinit(handle);
+}
+
+// Number of samples recorded when the first window is ready
+static int first_window_at(const int samples, const float min_fill, const MlDataFilters_t *filters,
+                           const int filter_size) {
+    MldpHandle_t handle = init_filter_processor(samples, 1, min_fill, false, filters, filter_size, NULL);
+    CHECK(handle != NULL);
+    if (handle == NULL) return -1;
+    int ready_at = -1;
+    for (int i = 0; i < samples && ready_at < 0; i++) {
+        const float value = sample_value(i);
+        mlFilterDataProcessor.recordData(handle, &value, 1);
+        if (mlFilterDataProcessor.isDataReady(handle, NULL)) {
+            ready_at = i + 1;
+            // Every partial window reported has to be processed
+            CHECK(mlFilterDataProcessor.getProcessedData(handle) != NULL);
+            CHECK(mlFilterDataProcessor.isWindowPartial(handle) == (ready_at < samples));
+        }
+    }
+    mlFilterDataProcessor.deinit(handle);
+    return ready_at;
+}
+
+static void test_min_fill(void) {
+    CHECK(first_window_at(20, 0, max_filter, 1) == 20);
+    CHECK(first_window_at(20, 1, max_filter, 1) == 20);
+    CHECK(first_window_at(20, 0.5f, max_filter, 1) == 10);
+    // Rounded up, and to at least one sample
+    CHECK(first_window_at(20, 0.51f, max_filter, 1) == 11);
+    CHECK(first_window_at(20, 0.01f, max_filter, 1) == 1);
+    // Enough samples for the peaks and zero crossing rate filters
+    CHECK(first_window_at(20, 0.05f, ml_trainer_filters, ml_trainer_filters_len) == 5);
+    const MlDataFilters_t zcr_filter[] = { { .out_size = 1, .filter = filterZcr } };
+    CHECK(first_window_at(20, 0.01f, zcr_filter, 1) == 2);
+}
+
+static void test_min_fill_invalid(void) {
+    MldpReturn_t result = MLDP_SUCCESS;
+    CHECK(init_filter_processor(20, 1, -0.1f, false, max_filter, 1, &result) == NULL);
+    CHECK(result == MLDP_ERROR_CONFIG);
+    CHECK(init_filter_processor(20, 1, 1.1f, false, max_filter, 1, &result) == NULL);
+    CHECK(result == MLDP_ERROR_CONFIG);
+    // The full window is already too short for the peaks filter
+    CHECK(init_filter_processor(4, 1, 0.25f, false, ml_trainer_filters, ml_trainer_filters_len, &result) == NULL);
+    CHECK(result == MLDP_ERROR_CONFIG);
+}
+
+// A partial window gives the same output as the filters on the samples so far
+static void test_partial_window_output(void) {
+    MldpHandle_t handle = init_filter_processor(
+        20, 1, 0.3f, false, ml_trainer_filters, ml_trainer_filters_len, NULL);
+    CHECK(handle != NULL);
+    float values[20];
+    for (int i = 0; i < 20; i++) {
+        values[i] = sample_value(i);
+        mlFilterDataProcessor.recordData(handle, &values[i], 1);
+        if (!mlFilterDataProcessor.isDataReady(handle, NULL)) continue;
+        const float *output = mlFilterDataProcessor.getProcessedData(handle);
+        CHECK(output != NULL);
+        if (output == NULL) break;
+        float expected[MLDP_ML_TRAINER_OUT_SIZE];
+        filterMlTrainer(values, i + 1, expected, MLDP_ML_TRAINER_OUT_SIZE);
+        for (int o_i = 0; o_i < MLDP_ML_TRAINER_OUT_SIZE; o_i++) {
+            CHECK_NEAR(output[o_i], expected[o_i], 1e-4f);
+        }
+    }
+    mlFilterDataProcessor.deinit(handle);
+}
+
+int main(void) {
+    RUN_TEST(test_hop);
+    RUN_TEST(test_missed_hops);
+    RUN_TEST(test_missed_hops_during_snapshot);
+    RUN_TEST(test_raw_windows);
+    RUN_TEST(test_min_fill);
+    RUN_TEST(test_min_fill_invalid);
+    RUN_TEST(test_partial_window_output);
+    return TEST_RESULT();
+}
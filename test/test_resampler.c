@@ -0,0 +1,64 @@
+/**
+ * @brief Start-up of the resampler, from the first input sample.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ */
+#include "mldpresampler.h"
+#include "test.h"
+
+#define DIMENSIONS 2
+#define MAX_OUTPUTS 4
+
+static const float dc[DIMENSIONS] = { 1.25f, -0.5f };
+
+// Pushes a constant input and checks every output equals it, the first ones
+// included, in the given mode
+static void check_dc(const int input_period, const int output_period, const MldpResampleMode_t mode) {
+    MldpResampler_t rs;
+    CHECK(mldpResampler_init(&rs, DIMENSIONS, input_period, output_period) == MLDP_SUCCESS);
+    CHECK(rs.mode == mode);
+    CHECK(mldpResampler_maxOutputs(&rs) <= MAX_OUTPUTS);
+
+    int total = 0;
+    for (int i = 0; i < 50; i++) {
+        float out[MAX_OUTPUTS * DIMENSIONS];
+        const int outputs = mldpResampler_push(&rs, dc, out);
+        for (int o_i = 0; o_i < outputs * DIMENSIONS; o_i++) {
+            CHECK_NEAR(out[o_i], dc[o_i % DIMENSIONS], 1e-5f);
+        }
+        total += outputs;
+    }
+    CHECK(total > 0);
+    mldpResampler_deinit(&rs);
+}
+
+static void test_decimate_dc_from_first_output(void) {
+    check_dc(10, 20, MLDP_RESAMPLE_DECIMATE);
+    check_dc(10, 30, MLDP_RESAMPLE_DECIMATE);
+    check_dc(4, 20, MLDP_RESAMPLE_DECIMATE);
+}
+
+static void test_linear_dc_from_first_output(void) {
+    check_dc(20, 30, MLDP_RESAMPLE_LINEAR);
+    check_dc(30, 20, MLDP_RESAMPLE_LINEAR);
+}
+
+// The first input is output straight away, then one output every factor inputs
+static void test_decimate_output_times(void) {
+    MldpResampler_t rs;
+    CHECK(mldpResampler_init(&rs, DIMENSIONS, 10, 30) == MLDP_SUCCESS);
+    for (int i = 0; i < 12; i++) {
+        float out[DIMENSIONS];
+        CHECK(mldpResampler_push(&rs, dc, out) == (i % 3 == 0 ? 1 : 0));
+    }
+    mldpResampler_deinit(&rs);
+}
+
+int main(void) {
+    RUN_TEST(test_decimate_dc_from_first_output);
+    RUN_TEST(test_linear_dc_from_first_output);
+    RUN_TEST(test_decimate_output_times);
+    return TEST_RESULT();
+}
@@ -0,0 +1,92 @@
+/**
+ * @brief Samples recorded with a timestamp, onto the samples period grid.
+ *
+ * @copyright
+ * Copyright 2024 Micro:bit Educational Foundation.
+ * SPDX-License-Identifier: MIT
+ */
+#include "mldataprocessor.h"
+#include "test.h"
+
+#define SAMPLES 16
+#define DIMENSIONS 3
+#define PERIOD 20000
+
+static const float scale[DIMENSIONS] = { 0.001f, 0.001f, 0.002f };
+
+static const MlDataFilters_t filters[] = {
+    { .out_size = SAMPLES, .filter = filterPassThrough },
+};
+
+static MldpHandle_t init_processor(const MlDataProcessor_t *processor, const MldpStorage_t storage) {
+    const MlDataProcessorConfig_t config = {
+        .samples = SAMPLES,
+        .dimensions = DIMENSIONS,
+        .output_length = SAMPLES * DIMENSIONS,
+        .filter_size = processor == &mlFilterDataProcessor ? 1 : 0,
+        .filters = filters,
+        .storage = storage,
+        .scale = scale,
+        .samples_period = PERIOD,
+    };
+    return processor->init(&config, NULL);
+}
+
+// Raw samples with late and early timestamps, recorded as raw values and
+// as scaled floats, end up with the same window and timing statistics
+static void check_timed_int16(const MlDataProcessor_t *processor, const MldpStorage_t storage) {
+    MldpHandle_t raw_handle = init_processor(processor, storage);
+    MldpHandle_t float_handle = init_processor(processor, storage);
+    CHECK(raw_handle != NULL && float_handle != NULL);
+
+    const int32_t offsets[] = { 0, 3000, -2000, 500, 9000, -4000, 0, 1000 };
+    for (int i = 0; i < 40; i++) {
+        const uint32_t timestamp = 1000 + i * PERIOD + offsets[i % 8];
+        const int16_t raw[DIMENSIONS] = { (int16_t)(i * 100 - 2000), (int16_t)(i * -37), (int16_t)(i % 5 * 250) };
+        float values[DIMENSIONS];
+        for (int d_i = 0; d_i < DIMENSIONS; d_i++) {
+            values[d_i] = raw[d_i] * scale[d_i];
+        }
+        CHECK(processor->recordDataTimedInt16(raw_handle, raw, DIMENSIONS, timestamp) == MLDP_SUCCESS);
+        CHECK(processor->recordDataTimed(float_handle, values, DIMENSIONS, timestamp) == MLDP_SUCCESS);
+    }
+
+    float raw_window[SAMPLES * DIMENSIONS], float_window[SAMPLES * DIMENSIONS];
+    int raw_count = 0, float_count = 0;
+    CHECK(processor->getSamples(raw_handle, raw_window, DIMENSIONS, SAMPLES, &raw_count) == MLDP_SUCCESS);
+    CHECK(processor->getSamples(float_handle, float_window, DIMENSIONS, SAMPLES, &float_count) == MLDP_SUCCESS);
+    CHECK(raw_count == SAMPLES && float_count == SAMPLES);
+    for (int i = 0; i < SAMPLES * DIMENSIONS; i++) {
+        // Up to one raw unit apart, from rounding the interpolation
+        CHECK_NEAR(raw_window[i], float_window[i], scale[i % DIMENSIONS] * 1.01f);
+    }
+
+    MldpJitter_t raw_jitter, float_jitter;
+    CHECK(processor->getJitter(raw_handle, &raw_jitter, false) == MLDP_SUCCESS);
+    CHECK(processor->getJitter(float_handle, &float_jitter, false) == MLDP_SUCCESS);
+    CHECK(raw_jitter.intervals == 39 && float_jitter.intervals == 39);
+    CHECK(raw_jitter.max_deviation == float_jitter.max_deviation);
+    CHECK(raw_jitter.min_deviation == float_jitter.min_deviation);
+
+    processor->deinit(raw_handle);
+    processor->deinit(float_handle);
+}
+
+static void test_timed_int16_filter_float_storage(void) {
+    check_timed_int16(&mlFilterDataProcessor, MLDP_STORAGE_FLOAT);
+}
+
+static void test_timed_int16_filter_int16_storage(void) {
+    check_timed_int16(&mlFilterDataProcessor, MLDP_STORAGE_INT16);
+}
+
+static void test_timed_int16_raw(void) {
+    check_timed_int16(&mlRawDataProcessor, MLDP_STORAGE_FLOAT);
+}
+
+int main(void) {
+    RUN_TEST(test_timed_int16_filter_float_storage);
+    RUN_TEST(test_timed_int16_filter_int16_storage);
+    RUN_TEST(test_timed_int16_raw);
+    return TEST_RESULT();
+}
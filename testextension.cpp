@@ -1,11 +1,13 @@
 #include <pxt.h>
 #include "mlrunner/mlrunner.h"
 #include "mlrunner/mldataprocessor.h"
+#include "mlrunner/mldppipeline.h"
 #include "mlrunner/example_model1.h"
 
 // Using defines to avoid MakeCode exposing the enum to enums.d.ts
 #define TEST_RUNNER_ID_INFERENCE 71
 #define TEST_RUNNER_ID_TIMER 72
+#define TEST_RUNNER_ID_PROCESS 73
 #define TEST_RUNNER_ERROR 800
 
 // Enable/disable debug print to serial, can be set in pxt.json
@@ -18,6 +20,51 @@
 #define DEBUG_PRINT(...)
 #endif
 
+// Print how long the data processor takes with each samples buffer layout
+#ifndef ML_BENCHMARK_LAYOUTS
+#define ML_BENCHMARK_LAYOUTS 0
+#endif
+
+// Accelerometer period in ms, the samples are resampled to the model period.
+// Set to 0 to sample at the model period instead.
+#ifndef ML_SENSOR_PERIOD_MS
+#define ML_SENSOR_PERIOD_MS 0
+#endif
+
+// Percentage of the samples window needed for the first predictions, which
+// are flagged as low confidence until the window is filled. 0 to disable.
+#ifndef ML_MIN_WINDOW_FILL_PERCENT
+#define ML_MIN_WINDOW_FILL_PERCENT 0
+#endif
+
+// Update the filters as each sample is recorded, instead of over the whole
+// window every time the model runs
+#ifndef ML_INCREMENTAL_FILTERS
+#define ML_INCREMENTAL_FILTERS 0
+#endif
+
+// Run the model on a snapshot of the window, so that samples can still be
+// recorded while it runs
+#ifndef ML_DOUBLE_BUFFERED
+#define ML_DOUBLE_BUFFERED 0
+#endif
+
+// Store the samples as int16 values scaled by ML_ACC_SCALE, half the memory
+#ifndef ML_INT16_STORAGE
+#define ML_INT16_STORAGE 0
+#endif
+
+// Write the filter outputs directly to the model input, instead of copying
+#ifndef ML_OUTPUT_TO_MODEL_INPUT
+#define ML_OUTPUT_TO_MODEL_INPUT 0
+#endif
+
+// Timestamp the samples, to place late ones on the samples period grid and
+// print the sampling jitter
+#ifndef ML_TIMED_SAMPLES
+#define ML_TIMED_SAMPLES 0
+#endif
+
 
 static inline void start_ticks_cpu() {
     CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
@@ -54,33 +101,126 @@ static inline uint32_t calcTicks(uint32_t ticks_start, uint32_t ticks_end) {
 
 namespace testrunner {
     static bool initialised = false;
+    static ml_model_ctx_t *mlModel = NULL;
     static ml_actions_t *actions = NULL;
     static ml_predictions_t *predictions = NULL;
-    static int ml_sample_counts_per_prediction = 0;
+    static MldpHandle_t mlDataProcessorHandle = NULL;
     static const int ML_PREDICTIONS_PER_SECOND = 4;
     static const uint16_t ML_CODAL_TIMER_VALUE = 1;
+    static const float ML_ACC_SCALE[3] = { 0.001f, 0.001f, 0.001f };
 
     // Order is important for the outputData as set in:
     // https://github.com/microbit-foundation/ml-trainer/blob/v0.6.0/src/script/stores/mlStore.ts#L122-L131
     static const MlDataFilters_t mlTrainerDataFilters[] = {
-        {1, filterMax},
-        {1, filterMean},
-        {1, filterMin},
-        {1, filterStdDev},
-        {1, filterPeaks},
-        {1, filterTotalAcc},
-        {1, filterZcr},
-        {1, filterRms},
+        { .out_size = 1, .filter = filterMax },
+        { .out_size = 1, .filter = filterMean },
+        { .out_size = 1, .filter = filterMin },
+        { .out_size = 1, .filter = filterStdDev },
+        { .out_size = 1, .filter = filterPeaks },
+        { .out_size = 1, .filter = filterTotalAcc },
+        { .out_size = 1, .filter = filterZcr },
+        { .out_size = 1, .filter = filterRms },
     };
     static const int mlTrainerDataFiltersLen = sizeof(mlTrainerDataFilters) / sizeof(mlTrainerDataFilters[0]);
 
-    void runModel() {
+#if ML_BENCHMARK_LAYOUTS
+    // A set of cheap filters, where copying the window dominates the time
+    static const MlDataFilters_t benchmarkDataFilters[] = {
+        { .out_size = 1, .filter = filterMax },
+        { .out_size = 1, .filter = filterMin },
+        { .out_size = 1, .filter = filterMean },
+        { .out_size = 1, .filter = filterRms },
+    };
+    static const int benchmarkDataFiltersLen = sizeof(benchmarkDataFilters) / sizeof(benchmarkDataFilters[0]);
+
+    // The same filter sets as compile time pipelines, for the ML-Trainer window
+    static const int BENCHMARK_PIPELINE_SAMPLES = 80;
+    typedef MldpPipeline<BENCHMARK_PIPELINE_SAMPLES,
+        filterMax, filterMean, filterMin, filterStdDev,
+        filterPeaks, filterTotalAcc, filterZcr, filterRms
+    > benchmarkMlTrainerPipeline;
+    typedef MldpPipeline<BENCHMARK_PIPELINE_SAMPLES,
+        filterMax, filterMin, filterMean, filterRms
+    > benchmarkCheapPipeline;
+
+    void benchmarkLayouts(const int samplesLen, const int sampleDimensions) {
+        static const int BENCHMARK_RUNS = 20;
+        const struct {
+            const char *name;
+            const MlDataFilters_t *filters;
+            const int len;
+            const MldpPipeline_t *pipeline;
+        } filterSets[] = {
+            {"ML-Trainer", mlTrainerDataFilters, mlTrainerDataFiltersLen, NULL},
+            {"Cheap", benchmarkDataFilters, benchmarkDataFiltersLen, NULL},
+            {"ML-Trainer pipeline", NULL, 0, &mldpPipeline<benchmarkMlTrainerPipeline>()},
+            {"Cheap pipeline", NULL, 0, &mldpPipeline<benchmarkCheapPipeline>()},
+        };
+        const struct {
+            const char *name;
+            const MldpLayout_t layout;
+        } layouts[] = {
+            {"ring", MLDP_LAYOUT_RING},
+            {"mirrored", MLDP_LAYOUT_MIRRORED},
+        };
+
+        start_ticks_cpu();
+        for (size_t f_i = 0; f_i < sizeof(filterSets) / sizeof(filterSets[0]); f_i++) {
+            const MldpPipeline_t *pipeline = filterSets[f_i].pipeline;
+            if (pipeline != NULL && pipeline->samples != samplesLen) {
+                DEBUG_PRINT("Benchmark %s skipped, built for %d samples\n", filterSets[f_i].name, pipeline->samples);
+                continue;
+            }
+            for (size_t l_i = 0; l_i < sizeof(layouts) / sizeof(layouts[0]); l_i++) {
+                const MlDataProcessorConfig_t benchmarkConfig = {
+                    .samples = samplesLen,
+                    .dimensions = sampleDimensions,
+                    .output_length = (pipeline != NULL ? pipeline->out_size : filterSets[f_i].len) * sampleDimensions,
+                    .filter_size = filterSets[f_i].len,
+                    .filters = filterSets[f_i].filters,
+                    .incremental = false,
+                    .layout = layouts[l_i].layout,
+                    .double_buffered = false,
+                    .storage = MLDP_STORAGE_FLOAT,
+                    .scale = NULL,
+                    .pipeline = pipeline,
+                };
+                MldpHandle_t benchmarkHandle = mlFilterDataProcessor.init(&benchmarkConfig, NULL);
+                if (benchmarkHandle == NULL) {
+                    DEBUG_PRINT("Benchmark failed to initialise the data processor\n");
+                    continue;
+                }
+                // Fill one and a half windows, so that the ring has wrapped around
+                float sample[sampleDimensions];
+                for (int s_i = 0; s_i < samplesLen + samplesLen / 2; s_i++) {
+                    for (int d_i = 0; d_i < sampleDimensions; d_i++) {
+                        sample[d_i] = (float)((s_i * (d_i + 1)) % 17) / 8.0f - 1.0f;
+                    }
+                    mlFilterDataProcessor.recordData(benchmarkHandle, sample, sampleDimensions);
+                }
+                uint32_t ticksTotal = 0;
+                for (int r_i = 0; r_i < BENCHMARK_RUNS; r_i++) {
+                    const uint32_t ticks_start = ticks_cpu();
+                    mlFilterDataProcessor.getProcessedData(benchmarkHandle);
+                    ticksTotal += ticks_cpu() - ticks_start;
+                }
+                DEBUG_PRINT("Benchmark %s filters, %s layout: %d ticks\n",
+                            filterSets[f_i].name, layouts[l_i].name, ticksTotal / BENCHMARK_RUNS);
+                mlFilterDataProcessor.deinit(benchmarkHandle);
+            }
+        }
+    }
+#endif
+
+    // Runs from its own listener, on the snapshot taken by recordAccData()
+    // when double buffered, so new samples can be recorded meanwhile
+    void runModel(MicroBitEvent) {
         if (!initialised) return;
 
         unsigned int time_start = system_timer_current_time_us();
 
         int32_t ticks_start = ticks_cpu() & 0x7FFFFFFF;
-        float *modelData = mlDataProcessor.getProcessedData();
+        float *modelData = mlFilterDataProcessor.getProcessedData(mlDataProcessorHandle);
         int32_t ticks_end = ticks_cpu() & 0x7FFFFFFF;
         if (modelData == NULL) {
             DEBUG_PRINT("Failed to processed data for the model\n");
@@ -89,16 +229,20 @@ namespace testrunner {
 
         unsigned int time_mid = system_timer_current_time_us();
 
+        // With ML_OUTPUT_TO_MODEL_INPUT modelData is already the model input,
+        // and ml_predict() doesn't copy it
         bool success = ml_predict(
-            modelData, mlDataProcessor.getProcessedDataSize(), actions, predictions);
+            mlModel, modelData, mlFilterDataProcessor.getProcessedDataSize(mlDataProcessorHandle), actions, predictions);
         if (!success) {
             DEBUG_PRINT("Failed to run model\n");
             uBit.panic(TEST_RUNNER_ERROR + 22);
         }
+        predictions->low_confidence = mlFilterDataProcessor.isWindowPartial(mlDataProcessorHandle);
 
         unsigned int time_end = system_timer_current_time_us();
 
-        DEBUG_PRINT("Prediction (%d micros + %d micros, %d ticks): ",
+        DEBUG_PRINT("Prediction%s (%d micros + %d micros, %d ticks): ",
+                    predictions->low_confidence ? " (low confidence)" : "",
                     time_mid - time_start, time_end - time_mid, calcTicks(ticks_start, ticks_end));
         if (predictions->index >= 0) {
             DEBUG_PRINT("%d %s\n",
@@ -113,7 +257,20 @@ namespace testrunner {
                         actions->action[i].label,
                         (int)(predictions->prediction[i] * 100));
         }
-        DEBUG_PRINT("\n\n");
+        DEBUG_PRINT("\n");
+
+#if ML_TIMED_SAMPLES
+        // Late or dropped samples show that the scheduler is overloaded
+        MldpJitter_t jitter;
+        if (mlFilterDataProcessor.getJitter(mlDataProcessorHandle, &jitter, true) == MLDP_SUCCESS) {
+            DEBUG_PRINT("\tSample jitter: %d to %d micros, mean %d micros, %d missed\n",
+                        (int)jitter.min_deviation, (int)jitter.max_deviation,
+                        (int)jitter.mean_deviation, (int)jitter.missed);
+        }
+#endif
+        DEBUG_PRINT("\n");
+
+        mlFilterDataProcessor.commit(mlDataProcessorHandle);
 
         MicroBitEvent evt(TEST_RUNNER_ID_INFERENCE, predictions->index + 2);
     }
@@ -121,22 +278,37 @@ namespace testrunner {
     void recordAccData(MicroBitEvent) {
         if (!initialised) return;
 
+#if ML_TIMED_SAMPLES
+        // Timestamped in microseconds, so that the data processor can place
+        // late samples on the samples period grid and measure the jitter
+        const uint32_t timestamp = (uint32_t)system_timer_current_time_us();
+#endif
         const Sample3D accSample = uBit.accelerometer.getSample();
-        const float accData[3] = {
-            accSample.x / 1000.0f,
-            accSample.y / 1000.0f,
-            accSample.z / 1000.0f,
+        // Raw values, the data processor scales them with ML_ACC_SCALE
+        const int16_t accData[3] = {
+            (int16_t)accSample.x,
+            (int16_t)accSample.y,
+            (int16_t)accSample.z,
         };
-        MldpReturn_t recordDataResult = mlDataProcessor.recordData(accData, 3);
+#if ML_TIMED_SAMPLES
+        MldpReturn_t recordDataResult = mlFilterDataProcessor.recordDataTimedInt16(mlDataProcessorHandle, accData, 3, timestamp);
+#else
+        MldpReturn_t recordDataResult = mlFilterDataProcessor.recordDataInt16(mlDataProcessorHandle, accData, 3);
+#endif
         if (recordDataResult != MLDP_SUCCESS) {
             DEBUG_PRINT("Failed to record accelerometer data\n");
             return;
         }
 
-        // Run model every ml_sample_counts_per_prediction samples
-        static unsigned int samplesTaken = 0;
-        if (!(++samplesTaken % ml_sample_counts_per_prediction) && mlDataProcessor.isDataReady()) {
-            runModel();
+        // The data processor is ready once per hop, set from the predictions per second
+        int missedHops = 0;
+        if (mlFilterDataProcessor.isDataReady(mlDataProcessorHandle, &missedHops)) {
+            if (missedHops > 0) {
+                DEBUG_PRINT("Model still running, %d predictions skipped\n", missedHops);
+            }
+            if (mlFilterDataProcessor.snapshot(mlDataProcessorHandle) == MLDP_SUCCESS) {
+                MicroBitEvent evt(TEST_RUNNER_ID_PROCESS, ML_CODAL_TIMER_VALUE);
+            }
         }
     }
 
@@ -169,60 +341,65 @@ namespace testrunner {
         const int expectedDimensions = 3;
 #endif
 
-        const bool setModelSuccess = ml_setModel(model_address);
+        mlModel = ml_allocateContext();
+        if (mlModel == NULL) {
+            DEBUG_PRINT("Failed to allocate memory for the model context\n");
+            uBit.panic(TEST_RUNNER_ERROR + 13);
+        }
+        const bool setModelSuccess = ml_setModel(mlModel, model_address);
         if (!setModelSuccess) {
             DEBUG_PRINT("Model magic invalid\n");
             uBit.panic(TEST_RUNNER_ERROR + 2);
         }
 
-        const int samplesLen = ml_getSamplesLength();
+        const int samplesLen = ml_getSamplesLength(mlModel);
         DEBUG_PRINT("\tModel samples length: %d\n", samplesLen);
         if (samplesLen <= 0) {
             DEBUG_PRINT("Model samples length invalid\n");
             uBit.panic(TEST_RUNNER_ERROR + 3);
         }
 
-        const int sampleDimensions = ml_getSampleDimensions();
+        const int sampleDimensions = ml_getSampleDimensions(mlModel);
         DEBUG_PRINT("\tModel sample dimensions: %d\n", sampleDimensions);
         if (sampleDimensions != expectedDimensions) {
             DEBUG_PRINT("Model sample dimensions invalid\n");
             uBit.panic(TEST_RUNNER_ERROR + 4);
         }
 
-        const int samplesPeriodMillisec = ml_getSamplesPeriod();
+        const int samplesPeriodMillisec = ml_getSamplesPeriod(mlModel);
         DEBUG_PRINT("\tModel samples period: %d ms\n", samplesPeriodMillisec);
         if (samplesPeriodMillisec <= 0) {
             DEBUG_PRINT("Model samples period invalid\n");
             uBit.panic(TEST_RUNNER_ERROR + 5);
         }
 
-        const int modelInputLen = ml_getInputLength();
+        const int modelInputLen = ml_getInputLength(mlModel);
         DEBUG_PRINT("\tModel input length: %d\n", modelInputLen);
         if (modelInputLen <= 0) {
             DEBUG_PRINT("Model input length invalid\n");
             uBit.panic(TEST_RUNNER_ERROR + 6);
         }
 
-        const int modelOutputLen = ml_getInputLength();
+        const int modelOutputLen = ml_getOutputLength(mlModel);
         DEBUG_PRINT("\tModel output length: %d\n", modelOutputLen);
         if (modelOutputLen <= 0) {
             DEBUG_PRINT("Model output length invalid\n");
             uBit.panic(TEST_RUNNER_ERROR + 7);
         }
 
-        const int modelArenaSize = ml_getArenaSize();
+        const int modelArenaSize = ml_getArenaSize(mlModel);
         DEBUG_PRINT("\tModel arena size: %d bytes\n", modelArenaSize);
         if (modelArenaSize <= 0) {
             DEBUG_PRINT("Model arena size length invalid\n");
             uBit.panic(TEST_RUNNER_ERROR + 8);
         }
 
-        actions = ml_allocateActions();
+        actions = ml_allocateActions(mlModel);
         if (actions == NULL) {
             DEBUG_PRINT("Failed to allocate memory for actions\n");
             uBit.panic(TEST_RUNNER_ERROR + 9);
         }
-        const bool getActionsSuccess = ml_getActions(actions);
+        const bool getActionsSuccess = ml_getActions(mlModel, actions);
         if (!getActionsSuccess) {
             DEBUG_PRINT("Failed to retrieve actions\n");
             uBit.panic(TEST_RUNNER_ERROR + 10);
@@ -232,14 +409,23 @@ namespace testrunner {
             DEBUG_PRINT("\t\t'%s' threshold = %d%%\n", actions->action[i].label, (int)(actions->action[i].threshold * 100));
         }
 
-        predictions = ml_allocatePredictions();
+        predictions = ml_allocatePredictions(mlModel);
         if (predictions == NULL) {
             DEBUG_PRINT("Failed to allocate memory for predictions\n");
             uBit.panic(TEST_RUNNER_ERROR + 11);
         }
 
-        // Using sampling period to calculate how samples have to run for the next model run
-        ml_sample_counts_per_prediction = (1000 / ML_PREDICTIONS_PER_SECOND) / samplesPeriodMillisec;
+        // The timer records the accelerometer at the sensor period, if set
+        const int sensorPeriodMillisec = ML_SENSOR_PERIOD_MS > 0 ? ML_SENSOR_PERIOD_MS : samplesPeriodMillisec;
+
+        // Using the model sampling period to calculate how many samples are
+        // recorded between model runs, at least one for long periods
+        const int samplesPerPrediction = (1000 / ML_PREDICTIONS_PER_SECOND) / samplesPeriodMillisec;
+        const int samplesHop = samplesPerPrediction > 0 ? samplesPerPrediction : 1;
+
+#if ML_BENCHMARK_LAYOUTS
+        benchmarkLayouts(samplesLen, sampleDimensions);
+#endif
 
         const MlDataProcessorConfig_t mlDataConfig = {
             .samples = samplesLen,
@@ -247,9 +433,28 @@ namespace testrunner {
             .output_length = modelInputLen,
             .filter_size = mlDataFiltersLen,
             .filters = mlDataFilters,
+            .incremental = ML_INCREMENTAL_FILTERS != 0,
+            .layout = MLDP_LAYOUT_RING,
+            .double_buffered = ML_DOUBLE_BUFFERED != 0,
+            .storage = ML_INT16_STORAGE ? MLDP_STORAGE_INT16 : MLDP_STORAGE_FLOAT,
+            .scale = ML_ACC_SCALE,
+            .pipeline = NULL,
+            .derived_size = 0,
+            .derived = NULL,
+            .input_period = sensorPeriodMillisec * 1000,
+            .samples_period = samplesPeriodMillisec * 1000,
+            .hop = samplesHop,
+            .min_fill = ML_MIN_WINDOW_FILL_PERCENT / 100.0f,
+            .ring = NULL,
+#if ML_OUTPUT_TO_MODEL_INPUT
+            .output_buffer = ml_getInputBuffer(mlModel),
+#else
+            .output_buffer = NULL,
+#endif
         };
-        MldpReturn_t mlInitResult = mlDataProcessor.init(&mlDataConfig);
-        if (mlInitResult != MLDP_SUCCESS) {
+        MldpReturn_t mlInitResult = MLDP_SUCCESS;
+        mlDataProcessorHandle = mlFilterDataProcessor.init(&mlDataConfig, &mlInitResult);
+        if (mlDataProcessorHandle == NULL) {
             DEBUG_PRINT("Failed to initialise ML data processor (%d)\n", mlInitResult);
             // TODO: Check error type and set panic value accordingly
             uBit.panic(TEST_RUNNER_ERROR + 12);
@@ -257,7 +462,8 @@ namespace testrunner {
 
         // Set up background timer to collect data and run model
         uBit.messageBus.listen(TEST_RUNNER_ID_TIMER, ML_CODAL_TIMER_VALUE, &recordAccData, MESSAGE_BUS_LISTENER_DROP_IF_BUSY);
-        uBit.timer.eventEvery(samplesPeriodMillisec, TEST_RUNNER_ID_TIMER, ML_CODAL_TIMER_VALUE);
+        uBit.messageBus.listen(TEST_RUNNER_ID_PROCESS, ML_CODAL_TIMER_VALUE, &runModel, MESSAGE_BUS_LISTENER_DROP_IF_BUSY);
+        uBit.timer.eventEvery(sensorPeriodMillisec, TEST_RUNNER_ID_TIMER, ML_CODAL_TIMER_VALUE);
 
         start_ticks_cpu();
 